@@ -0,0 +1,261 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#include "ChannelIndex.h"
+
+#include "EpgIndex.h"
+#include "MenuSetupYaepg.h"
+#include "StateKeys.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+/*
+ *****************************************************************************
+ * cYaepgChannelViews
+ *****************************************************************************
+ */
+cYaepgChannelViews::cYaepgChannelViews(const cChannels *channels, const cYaepgEpgSnapshot *snapshot) :
+   refs(1)
+{
+   bool newGroup = true;
+
+   for (const cChannel *c = channels->First(); c != NULL; c = channels->Next(c)) {
+      if (c->GroupSep()) {
+         newGroup = true;
+         continue;
+      }
+
+      int pos = chans.size();
+      if (newGroup) {
+         groups.push_back(pos);
+         newGroup = false;
+      }
+      positions[c] = pos;
+      numbers.push_back(std::make_pair(c->Number(), pos));
+      chans.push_back(c);
+
+      all.push_back(pos);
+      sources[c->Source()].push_back(pos);
+      if (c->Vpid() != 0) {
+         tv.push_back(pos);
+      }
+      if (c->Ca() < CA_ENCRYPTED_MIN) {
+         fta.push_back(pos);
+      }
+      const cYaepgEpgChannel *e = snapshot ? snapshot->Channel(c) : NULL;
+      if (e != NULL && e->Count() > 0) {
+         epg.push_back(pos);
+      }
+   }
+   std::sort(numbers.begin(), numbers.end());
+
+   YAEPG_INFO("Channel views built, %d channels in %d groups, %d sources",
+              (int)chans.size(), (int)groups.size(), (int)sources.size());
+}
+
+int
+cYaepgChannelViews::GroupOf(int pos) const
+{
+   /* The first group always starts at position 0 */
+   return std::upper_bound(groups.begin(), groups.end(), pos) - groups.begin() - 1;
+}
+
+tChannelView
+cYaepgChannelViews::Slice(const std::vector< int > &list, int from, int to)
+{
+   tChannelView view;
+
+   view.pos = (to > from) ? &list[from] : NULL;
+   view.count = to - from;
+   return view;
+}
+
+/*
+ * Returns the channels of a view, groups and sources are those of the given
+ * channel.  Views without channels show all of them.
+ */
+tChannelView
+cYaepgChannelViews::View(int type, const cChannel *chan) const
+{
+   tChannelView view = Slice(all, 0, all.size());
+
+   switch (type) {
+   case CHANNEL_VIEW_GROUP:
+      if (!groups.empty()) {
+         std::map< const cChannel *, int >::const_iterator it = positions.find(chan);
+         int g = GroupOf((it != positions.end()) ? it->second : 0);
+         view = Slice(all, groups[g], (g + 1 < (int)groups.size()) ? groups[g + 1] : all.size());
+      }
+      break;
+   case CHANNEL_VIEW_SOURCE:
+      if (chan != NULL) {
+         std::map< int, std::vector< int > >::const_iterator it = sources.find(chan->Source());
+         if (it != sources.end()) {
+            view = Slice(it->second, 0, it->second.size());
+         }
+      }
+      break;
+   case CHANNEL_VIEW_TV:
+      view = Slice(tv, 0, tv.size());
+      break;
+   case CHANNEL_VIEW_FTA:
+      view = Slice(fta, 0, fta.size());
+      break;
+   case CHANNEL_VIEW_EPG:
+      view = Slice(epg, 0, epg.size());
+      break;
+   default:
+      break;
+   }
+
+   if (view.count == 0) {
+      view = Slice(all, 0, all.size());
+   }
+   return view;
+}
+
+/*
+ * Returns the i-th channel of a view, wrapping around at both ends.
+ */
+const cChannel *
+cYaepgChannelViews::Get(const tChannelView &view, int i) const
+{
+   if (view.count == 0) {
+      return NULL;
+   }
+   i %= view.count;
+   return chans[view.pos[(i < 0) ? i + view.count : i]];
+}
+
+/*
+ * Returns the index of a channel in a view.  For channels not in the view
+ * it's the next one that is, and the first one for unknown channels.
+ */
+int
+cYaepgChannelViews::Find(const tChannelView &view, const cChannel *chan) const
+{
+   std::map< const cChannel *, int >::const_iterator it = positions.find(chan);
+
+   if (it == positions.end()) {
+      return 0;
+   }
+   int i = std::lower_bound(view.pos, view.pos + view.count, it->second) - view.pos;
+   return (i < view.count) ? i : 0;
+}
+
+/*
+ * Returns the first channel of the group "change" groups after (or before,
+ * if negative) the group of the given channel, wrapping around the list.
+ */
+const cChannel *
+cYaepgChannelViews::Group(const cChannel *chan, int change) const
+{
+   int n = groups.size();
+
+   if (n == 0) {
+      return chan;
+   }
+   std::map< const cChannel *, int >::const_iterator it = positions.find(chan);
+   int g = (GroupOf((it != positions.end()) ? it->second : 0) + change) % n;
+   return chans[groups[(g < 0) ? g + n : g]];
+}
+
+/*
+ * Returns the channel with the number closest to the given one, the higher
+ * one if two are equally close.
+ */
+const cChannel *
+cYaepgChannelViews::Nearest(int number) const
+{
+   if (numbers.empty()) {
+      return NULL;
+   }
+
+   std::vector< std::pair< int, int > >::const_iterator it;
+   it = std::lower_bound(numbers.begin(), numbers.end(), std::make_pair(number, 0));
+   if (it == numbers.end() ||
+       (it != numbers.begin() && number - (it - 1)->first < it->first - number)) {
+      it--;
+   }
+   return chans[it->second];
+}
+
+/*
+ *****************************************************************************
+ * cYaepgChannelIndex
+ *****************************************************************************
+ */
+cYaepgChannelIndex *cYaepgChannelIndex::instance = NULL;
+
+cYaepgChannelIndex::~cYaepgChannelIndex()
+{
+   if (current != NULL) {
+      current->Unref();
+   }
+}
+
+cYaepgChannelIndex *
+cYaepgChannelIndex::Instance(void)
+{
+   if (instance == NULL) {
+      instance = new cYaepgChannelIndex;
+   }
+   return instance;
+}
+
+void
+cYaepgChannelIndex::Destroy(void)
+{
+   delete instance;
+   instance = NULL;
+}
+
+void
+cYaepgChannelIndex::Publish(const cYaepgChannelViews *views)
+{
+   const cYaepgChannelViews *old;
+
+   mutex.Lock();
+   old = current;
+   current = views;
+   mutex.Unlock();
+
+   if (old != NULL) {
+      old->Unref();
+   }
+}
+
+/*
+ * Returns the current views with a reference taken, the caller has to
+ * Unref() them when done.  Until the EPG index thread has built them, e.g.
+ * while the index comes from the cache file, they are built right here.
+ */
+const cYaepgChannelViews *
+cYaepgChannelIndex::Acquire(void)
+{
+   mutex.Lock();
+   bool empty = (current == NULL);
+   mutex.Unlock();
+   if (empty) {
+      /* The first EPG index build publishes the views as well */
+      const cYaepgEpgSnapshot *epg = cYaepgEpgIndex::Instance()->Acquire();
+      mutex.Lock();
+      empty = (current == NULL);
+      mutex.Unlock();
+      if (empty) {
+         YAEPG_CHANNELS_READ;
+         Publish(new cYaepgChannelViews(Channels, epg));
+      }
+      epg->Unref();
+   }
+
+   cMutexLock lock(&mutex);
+   current->Ref();
+   return current;
+}
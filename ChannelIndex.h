@@ -0,0 +1,97 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include <vdr/channels.h>
+#include <vdr/thread.h>
+
+class cYaepgEpgSnapshot;
+
+/*
+ *****************************************************************************
+ * cYaepgChannelViews
+ *
+ * Flat array of the selectable channels (all but the group separators) in
+ * the order of the channel list, with the position of every channel and the
+ * position where each group starts.  Paging, wrapping around the end of the
+ * list and jumping between groups are index arithmetic instead of walks over
+ * the channel list.  For direct channel input the positions are also sorted
+ * by channel number, the channel closest to a number is a binary search.
+ *
+ * The filtered views of the guide are sorted arrays of positions as well:
+ * one per source, TV channels, free-to-air channels and channels with EPG
+ * data.  A group is a range of the full list.  A view is a slice of one of
+ * these arrays, so a filtered guide pages just like the full one.
+ *
+ * The views are built by the EPG index thread whenever it has looked at
+ * changed channels or schedules, while it holds both locks.  They are
+ * reference counted and never change once published; the guide keeps the
+ * views it was opened with.  Channel pointers stay valid as long as VDR
+ * keeps the channel, which it only deletes when the user edits the list.
+ *****************************************************************************
+ */
+struct tChannelView {
+   const int *pos;
+   int count;
+};
+
+class cYaepgChannelViews {
+private:
+   mutable int refs;
+   std::vector< const cChannel * > chans;
+   std::map< const cChannel *, int > positions;
+   std::vector< int > groups;
+   std::vector< std::pair< int, int > > numbers;
+   std::vector< int > all;
+   std::vector< int > tv;
+   std::vector< int > fta;
+   std::vector< int > epg;
+   std::map< int, std::vector< int > > sources;
+
+   ~cYaepgChannelViews() {}
+   int GroupOf(int pos) const;
+   static tChannelView Slice(const std::vector< int > &list, int from, int to);
+
+public:
+   cYaepgChannelViews(const cChannels *channels, const cYaepgEpgSnapshot *snapshot);
+   void Ref(void) const { __sync_add_and_fetch(&refs, 1); }
+   void Unref(void) const { if (__sync_sub_and_fetch(&refs, 1) == 0) delete this; }
+   tChannelView View(int type, const cChannel *chan) const;
+   const cChannel *Get(const tChannelView &view, int i) const;
+   int Find(const tChannelView &view, const cChannel *chan) const;
+   const cChannel *Group(const cChannel *chan, int change) const;
+   const cChannel *Nearest(int number) const;
+};
+
+/*
+ *****************************************************************************
+ * cYaepgChannelIndex
+ *
+ * Holds the latest channel views.
+ *****************************************************************************
+ */
+class cYaepgChannelIndex {
+private:
+   static cYaepgChannelIndex *instance;
+
+   cMutex mutex;
+   const cYaepgChannelViews *current;
+
+   cYaepgChannelIndex(void) : current(NULL) {}
+   ~cYaepgChannelIndex();
+
+public:
+   static cYaepgChannelIndex *Instance(void);
+   static void Destroy(void);
+   void Publish(const cYaepgChannelViews *views);
+   const cYaepgChannelViews *Acquire(void);
+};
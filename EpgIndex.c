@@ -0,0 +1,750 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#include "EpgIndex.h"
+
+#include "ChannelIndex.h"
+#include "GuiElements.h"
+#include "MenuSetupYaepg.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define INDEX_POLL_MS            1000
+#define INDEX_HISTORY            3600
+#define WORD_MIN_LEN             2
+#define INDEX_CACHE_FILE         "epgindex.bin"
+#define INDEX_CATCHUP            600
+#define INDEX_SLOT               1800
+
+static uint16_t
+GenreFlags(const cEvent *event)
+{
+   return ((event->Contents(0) >> 4) << CELL_GENRE_SHIFT) & CELL_GENRE;
+}
+
+static void
+SnapEvent(tEventSnap &snap, const cEvent *event)
+{
+   snap.id = event->EventID();
+   snap.start = event->StartTime();
+   snap.duration = event->Duration();
+   snap.vps = event->Vps();
+   snap.flags = GenreFlags(event);
+   snap.title.assign(event->Title() ? event->Title() : "");
+   snap.shortText.assign(event->ShortText() ? event->ShortText() : "");
+}
+
+static void
+SnapGap(tEventSnap &snap, time_t start, time_t stop)
+{
+   snap.id = 0;
+   snap.start = start;
+   snap.duration = stop - start;
+   snap.vps = 0;
+   snap.flags = 0;
+   snap.title.clear();
+   snap.shortText.clear();
+}
+
+/*
+ * Splits text into words and appends their FNV-1a hashes.  ASCII letters are
+ * folded to lower case, bytes of multibyte characters count as letters.
+ */
+static void
+HashWords(const char *text, std::vector< uint32_t > &hashes)
+{
+   const unsigned char *p = (const unsigned char *)text;
+
+   while (p != NULL && *p) {
+      uint32_t h = 2166136261u;
+      int len = 0;
+
+      while (*p && (isalnum(*p) || *p >= 0x80)) {
+         h = (h ^ (uint32_t)tolower(*p++)) * 16777619u;
+         len++;
+      }
+      if (len >= WORD_MIN_LEN) {
+         hashes.push_back(h);
+      }
+      while (*p && !(isalnum(*p) || *p >= 0x80)) {
+         p++;
+      }
+   }
+}
+
+/*
+ *****************************************************************************
+ * cYaepgEpgFile
+ *****************************************************************************
+ */
+cYaepgEpgFile::~cYaepgEpgFile()
+{
+   munmap(data, size);
+}
+
+/*
+ * Maps the file and checks that all records are within it and the entries of
+ * each channel are in order, NULL if there is no usable file.
+ */
+cYaepgEpgFile *
+cYaepgEpgFile::Open(const char *name)
+{
+   struct stat st;
+   int fd = open(name, O_RDONLY);
+
+   if (fd < 0) {
+      return NULL;
+   }
+   if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(tEpgFileHeader)) {
+      close(fd);
+      return NULL;
+   }
+   void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (data == MAP_FAILED) {
+      YAEPG_ERROR("Can't map %s", name);
+      return NULL;
+   }
+
+   cYaepgEpgFile *file = new cYaepgEpgFile(data, st.st_size);
+   const tEpgFileHeader *h = file->Header();
+   uint64_t expect = sizeof(tEpgFileHeader) +
+                     (uint64_t)h->channels * sizeof(tEpgFileChannel) +
+                     (uint64_t)h->events * sizeof(tEpgFileEvent) +
+                     (uint64_t)h->words * sizeof(uint64_t) + h->strings;
+   bool valid = memcmp(h->magic, EPG_FILE_MAGIC, sizeof(h->magic)) == 0 &&
+                h->version == EPG_FILE_VERSION && expect == (uint64_t)st.st_size &&
+                h->strings > 0 && file->String(0)[0] == 0 &&
+                ((const char *)data)[st.st_size - 1] == 0;
+
+   for (uint32_t i = 0; valid && i < h->channels; i++) {
+      const tEpgFileChannel &c = file->Channels()[i];
+      valid = c.id[sizeof(c.id) - 1] == 0 &&
+              (uint64_t)c.firstEvent + c.numEvents <= h->events &&
+              (uint64_t)c.firstWord + c.numWords <= h->words;
+
+      /*
+       * The slot table is sized from the first and last entry, so the
+       * entries have to join up the way BuildChannel() writes them and may
+       * not span more than a few weeks.
+       */
+      const tEpgFileEvent *e = valid ? file->Events() + c.firstEvent : NULL;
+      for (uint32_t k = 0; valid && k < c.numEvents; k++) {
+         valid = e[k].duration > 0 && e[k].start >= 0 &&
+                 e[k].start + e[k].duration - e[0].start <= EPG_FILE_MAX_SPAN &&
+                 (k == 0 || e[k].start == e[k - 1].start + e[k - 1].duration);
+      }
+   }
+   if (!valid) {
+      YAEPG_ERROR("Ignoring invalid EPG cache %s", name);
+      file->Unref();
+      return NULL;
+   }
+
+   return file;
+}
+
+const char *
+cYaepgEpgFile::String(uint32_t offset) const
+{
+   const char *strings = (const char *)(Words() + Header()->words);
+
+   return (offset < Header()->strings) ? strings + offset : "";
+}
+
+/*
+ *****************************************************************************
+ * cYaepgEpgChannel
+ *****************************************************************************
+ */
+cYaepgEpgChannel::cYaepgEpgChannel(void) :
+   refs(1),
+   file(NULL),
+   fileEvents(NULL),
+   fileWords(NULL),
+   numFileEvents(0),
+   numFileWords(0),
+   slotBase(0),
+   schedule(NULL),
+   modified(0),
+   built(0)
+{
+}
+
+cYaepgEpgChannel::cYaepgEpgChannel(cYaepgEpgFile *_file, const tEpgFileChannel &chan) :
+   refs(1),
+   file(_file),
+   fileEvents(_file->Events() + chan.firstEvent),
+   fileWords(_file->Words() + chan.firstWord),
+   numFileEvents(chan.numEvents),
+   numFileWords(chan.numWords),
+   slotBase(0),
+   schedule(NULL),
+   modified(0),
+   built(0)
+{
+   file->Ref();
+   BuildSlots();
+}
+
+cYaepgEpgChannel::~cYaepgEpgChannel()
+{
+   if (file != NULL) {
+      file->Unref();
+   }
+}
+
+void
+cYaepgEpgChannel::Get(int i, tEventSnap &snap) const
+{
+   if (file == NULL) {
+      snap = events[i];
+      return;
+   }
+
+   const tEpgFileEvent &e = fileEvents[i];
+   snap.id = e.id;
+   snap.start = e.start;
+   snap.duration = e.duration;
+   snap.vps = e.vps;
+   snap.flags = e.flags;
+   snap.title.assign(file->String(e.title));
+   snap.shortText.assign(file->String(e.shortText));
+}
+
+/*
+ * The entries join up, so their end times are sorted as well and one walk
+ * fills all slots.
+ */
+void
+cYaepgEpgChannel::BuildSlots(void)
+{
+   int n = Count();
+
+   slots.clear();
+   if (n == 0) {
+      return;
+   }
+
+   slotBase = Start(0) - (Start(0) % INDEX_SLOT);
+   slots.resize((EndTime(n - 1) - slotBase + INDEX_SLOT - 1) / INDEX_SLOT);
+   for (int k = 0, i = 0; k < (int)slots.size(); k++) {
+      time_t slotStart = slotBase + (time_t)k * INDEX_SLOT;
+      while (i < n && EndTime(i) <= slotStart) {
+         i++;
+      }
+      slots[k] = i;
+   }
+}
+
+/*
+ * Returns the first entry ending after t, Count() if there is none.
+ */
+int
+cYaepgEpgChannel::Find(time_t t) const
+{
+   int n = Count();
+
+   if (n == 0 || t < slotBase) {
+      return 0;
+   }
+   int k = (t - slotBase) / INDEX_SLOT;
+   if (k >= (int)slots.size()) {
+      return n;
+   }
+
+   /* Only steps within the slot if t isn't at its start */
+   int i = slots[k];
+   while (i < n && EndTime(i) <= t) {
+      i++;
+   }
+   return i;
+}
+
+/*
+ *****************************************************************************
+ * cYaepgEpgSnapshot
+ *****************************************************************************
+ */
+cYaepgEpgSnapshot::~cYaepgEpgSnapshot()
+{
+   for (tChannelMap::iterator it = channels.begin(); it != channels.end(); it++) {
+      it->second.events->Unref();
+   }
+}
+
+/*
+ * Takes over the reference to events, the channels have to be locked.
+ */
+void
+cYaepgEpgSnapshot::Add(const cChannel *chan, cYaepgEpgChannel *events)
+{
+   tSnapChannel &c = channels[chan];
+
+   c.events = events;
+   c.number = chan->Number();
+   c.id = chan->GetChannelID();
+   c.name.assign(chan->Name() ? chan->Name() : "");
+}
+
+cYaepgEpgChannel *
+cYaepgEpgSnapshot::Channel(const cChannel *chan) const
+{
+   tChannelMap::const_iterator it = channels.find(chan);
+
+   return (it != channels.end()) ? it->second.events : NULL;
+}
+
+/*
+ * Copies the entries covering [from, to) into row.  Times without EPG data,
+ * including those before the first and after the last event, come out as
+ * "No Info" entries.
+ */
+void
+cYaepgEpgSnapshot::Row(const cChannel *chan, time_t from, time_t to, std::vector< tEventSnap > &row) const
+{
+   const cYaepgEpgChannel *c = Channel(chan);
+   int n = c ? c->Count() : 0;
+   int lo = c ? c->Find(from) : 0;
+   time_t t = from;
+
+   row.clear();
+   while (t < to) {
+      row.resize(row.size() + 1);
+      tEventSnap &snap = row.back();
+      if (lo >= n) {
+         SnapGap(snap, t, to);
+      } else if (c->Start(lo) > t) {
+         SnapGap(snap, t, c->Start(lo));
+      } else {
+         c->Get(lo++, snap);
+      }
+      if (snap.id == 0) {
+         snap.title.assign(tr("No Info"));
+      }
+      t = snap.EndTime();
+   }
+}
+
+/*
+ * Finds the events from "from" on containing all words of the query, sorted
+ * by start time.
+ */
+void
+cYaepgEpgSnapshot::Search(const char *query, time_t from, int maxHits, std::vector< tSearchHit > &hits) const
+{
+   std::vector< uint32_t > hashes;
+
+   hits.clear();
+   HashWords(query, hashes);
+   if (hashes.empty()) {
+      return;
+   }
+
+   for (tChannelMap::const_iterator it = channels.begin(); it != channels.end(); it++) {
+      const cYaepgEpgChannel *c = it->second.events;
+      const uint64_t *words = c->Words();
+      const uint64_t *end = words + c->NumWords();
+      const uint64_t *lo, *hi;
+
+      lo = std::lower_bound(words, end, (uint64_t)hashes[0] << 32);
+      hi = std::upper_bound(lo, end, ((uint64_t)hashes[0] << 32) | 0xFFFFFFFFu);
+      for (; lo != hi; lo++) {
+         uint32_t ev = (uint32_t)*lo;
+         bool match = (int)ev < c->Count() && c->EndTime(ev) > from;
+
+         for (int w = 1; match && w < (int)hashes.size(); w++) {
+            match = std::binary_search(words, end, ((uint64_t)hashes[w] << 32) | ev);
+         }
+         if (match) {
+            hits.resize(hits.size() + 1);
+            hits.back().chan = it->first;
+            hits.back().number = it->second.number;
+            hits.back().chanName = it->second.name;
+            c->Get(ev, hits.back().event);
+         }
+      }
+   }
+
+   std::sort(hits.begin(), hits.end());
+   if ((int)hits.size() > maxHits) {
+      hits.resize(maxHits);
+   }
+}
+
+static uint32_t
+Intern(std::map< std::string, uint32_t > &interned, std::string &pool, const std::string &str)
+{
+   std::map< std::string, uint32_t >::iterator it = interned.find(str);
+
+   if (it != interned.end()) {
+      return it->second;
+   }
+   uint32_t offset = pool.size();
+   pool.append(str.c_str(), str.size() + 1);
+   interned[str] = offset;
+   return offset;
+}
+
+/*
+ * Writes the snapshot in the cache file format.  The file is written under
+ * a temporary name and renamed, so a mapped older file is never changed.
+ */
+bool
+cYaepgEpgSnapshot::Write(const char *name) const
+{
+   std::vector< tEpgFileChannel > chans;
+   std::vector< tEpgFileEvent > events;
+   std::vector< uint64_t > words;
+   std::map< std::string, uint32_t > interned;
+   std::string pool(1, '\0');
+   tEventSnap snap;
+
+   interned[""] = 0;
+   for (tChannelMap::const_iterator it = channels.begin(); it != channels.end(); it++) {
+      const cYaepgEpgChannel *c = it->second.events;
+      tEpgFileChannel fc;
+
+      memset(&fc, 0, sizeof(fc));
+      strn0cpy(fc.id, *it->second.id.ToString(), sizeof(fc.id));
+      fc.firstEvent = events.size();
+      fc.numEvents = c->Count();
+      fc.firstWord = words.size();
+      fc.numWords = c->NumWords();
+      chans.push_back(fc);
+
+      for (int i = 0; i < c->Count(); i++) {
+         tEpgFileEvent fe;
+         c->Get(i, snap);
+         memset(&fe, 0, sizeof(fe));
+         fe.start = snap.start;
+         fe.vps = snap.vps;
+         fe.id = snap.id;
+         fe.duration = snap.duration;
+         fe.title = Intern(interned, pool, snap.title);
+         fe.shortText = Intern(interned, pool, snap.shortText);
+         fe.flags = snap.flags;
+         events.push_back(fe);
+      }
+      words.insert(words.end(), c->Words(), c->Words() + c->NumWords());
+   }
+
+   tEpgFileHeader h;
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, EPG_FILE_MAGIC, sizeof(h.magic));
+   h.version = EPG_FILE_VERSION;
+   h.channels = chans.size();
+   h.events = events.size();
+   h.words = words.size();
+   h.strings = pool.size();
+   h.saved = time(NULL);
+
+   cString tmpName = cString::sprintf("%s.tmp", name);
+   FILE *fp = fopen(tmpName, "w");
+   if (fp == NULL) {
+      YAEPG_ERROR("Can't write %s", *tmpName);
+      return false;
+   }
+   bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+             (chans.empty() || fwrite(&chans[0], sizeof(chans[0]), chans.size(), fp) == chans.size()) &&
+             (events.empty() || fwrite(&events[0], sizeof(events[0]), events.size(), fp) == events.size()) &&
+             (words.empty() || fwrite(&words[0], sizeof(words[0]), words.size(), fp) == words.size()) &&
+             fwrite(pool.data(), pool.size(), 1, fp) == 1;
+   ok = (fclose(fp) == 0) && ok;
+   if (!ok || rename(tmpName, name) < 0) {
+      YAEPG_ERROR("Can't write %s", name);
+      unlink(tmpName);
+      return false;
+   }
+
+   YAEPG_INFO("Saved %d channels, %d events to %s", (int)chans.size(), (int)events.size(), name);
+   return true;
+}
+
+/*
+ *****************************************************************************
+ * cYaepgEpgIndex
+ *****************************************************************************
+ */
+cYaepgEpgIndex *cYaepgEpgIndex::instance = NULL;
+
+cYaepgEpgIndex::cYaepgEpgIndex(void) :
+   cThread("yaepghd epg index", true),
+   current(NULL),
+   loaded(0),
+   version(0)
+{
+}
+
+cYaepgEpgIndex::~cYaepgEpgIndex()
+{
+   Cancel(-1);
+   wakeup.Signal();
+   Cancel(3);
+   if (current != NULL) {
+      current->Unref();
+   }
+}
+
+cYaepgEpgIndex *
+cYaepgEpgIndex::Instance(void)
+{
+   if (instance == NULL) {
+      instance = new cYaepgEpgIndex;
+      instance->Load();
+      instance->Start();
+   }
+   return instance;
+}
+
+void
+cYaepgEpgIndex::Destroy(void)
+{
+   if (instance != NULL) {
+      instance->Save();
+   }
+   delete instance;
+   instance = NULL;
+}
+
+/*
+ * Publishes the index saved on the last shutdown, so the first guide doesn't
+ * have to wait for the live EPG.
+ */
+void
+cYaepgEpgIndex::Load(void)
+{
+   cString name = AddDirectory(sCacheDir.c_str(), INDEX_CACHE_FILE);
+   cYaepgEpgFile *file = sCacheDir.empty() ? NULL : cYaepgEpgFile::Open(name);
+   int n = 0;
+
+   if (file == NULL) {
+      return;
+   }
+
+   YAEPG_CHANNELS_READ;
+   cYaepgEpgSnapshot *snapshot = new cYaepgEpgSnapshot(++version);
+   for (uint32_t i = 0; i < file->Header()->channels; i++) {
+      const tEpgFileChannel &fc = file->Channels()[i];
+      const cChannel *chan = Channels->GetByChannelID(tChannelID::FromString(fc.id));
+      if (chan != NULL) {
+         snapshot->Add(chan, new cYaepgEpgChannel(file, fc));
+         n++;
+      }
+   }
+   file->Unref();
+   loaded = time(NULL);
+   Publish(snapshot);
+
+   YAEPG_INFO("Loaded %d channels from %s", n, *name);
+}
+
+void
+cYaepgEpgIndex::Save(void)
+{
+   cMutexLock lock(&buildMutex);
+
+   if (current != NULL && !sCacheDir.empty()) {
+      current->Write(AddDirectory(sCacheDir.c_str(), INDEX_CACHE_FILE));
+   }
+}
+
+/*
+ * Events are sorted by start time.  Overlapping events are cut at the end of
+ * the previous one, gaps get an entry without EPG data, so consecutive
+ * entries always join up.
+ */
+cYaepgEpgChannel *
+cYaepgEpgIndex::BuildChannel(const cSchedule *sched, time_t from, time_t now)
+{
+   cYaepgEpgChannel *c = new cYaepgEpgChannel;
+   const cList< cEvent > *list = sched->Events();
+   std::vector< uint32_t > hashes;
+
+   c->schedule = sched;
+#if APIVERSNUM >= 20301
+   int state = -1;
+   sched->Modified(state);
+   c->modified = state;
+#else
+   c->modified = sched->Modification();
+#endif
+   c->built = now;
+
+   for (const cEvent *e = list->First(); e != NULL; e = list->Next(e)) {
+      time_t start = e->StartTime();
+      time_t stop = e->EndTime();
+
+      if (stop <= from || stop <= start) {
+         continue;
+      }
+      if (!c->events.empty()) {
+         time_t last = c->events.back().EndTime();
+         if (stop <= last) {
+            continue;
+         }
+         if (start < last) {
+            start = last;
+         } else if (start > last) {
+            c->events.resize(c->events.size() + 1);
+            SnapGap(c->events.back(), last, start);
+         }
+      }
+      c->events.resize(c->events.size() + 1);
+      tEventSnap &snap = c->events.back();
+      SnapEvent(snap, e);
+      snap.start = start;
+      snap.duration = stop - start;
+
+      /* Each word once per event */
+      uint64_t ev = c->events.size() - 1;
+      hashes.clear();
+      HashWords(e->Title(), hashes);
+      HashWords(e->ShortText(), hashes);
+      HashWords(e->Description(), hashes);
+      std::sort(hashes.begin(), hashes.end());
+      hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+      for (int i = 0; i < (int)hashes.size(); i++) {
+         c->words.push_back(((uint64_t)hashes[i] << 32) | ev);
+      }
+   }
+   std::sort(c->words.begin(), c->words.end());
+   std::vector< uint64_t >(c->words).swap(c->words);
+   c->BuildSlots();
+
+   return c;
+}
+
+/*
+ * Whether the list of a channel is still up to date with its schedule.
+ */
+static bool
+Unchanged(const cYaepgEpgChannel *c, const cSchedule *sched)
+{
+#if APIVERSNUM >= 20301
+   int state = c->modified;
+   return !sched->Modified(state);
+#else
+   /*
+    * Modification times have a resolution of one second, a list built in
+    * the second the schedule was modified may have missed a change.
+    */
+   return c->modified == sched->Modification() && c->modified < c->built;
+#endif
+}
+
+/*
+ * Returns false if the lists couldn't be locked, the change then still has
+ * to be built.
+ */
+bool
+cYaepgEpgIndex::Build(void)
+{
+   cMutexLock lock(&buildMutex);
+   time_t now = time(NULL);
+   int built = 0;
+
+   cYaepgEpgLock epgLock(100);
+   const cChannels *Channels = epgLock.Channels();
+   const cSchedules *Schedules = epgLock.Schedules();
+   if (Channels == NULL || Schedules == NULL) {
+      /* Try again later, but readers need something to look at right away */
+      if (current == NULL) {
+         Publish(new cYaepgEpgSnapshot(++version));
+      }
+      return false;
+   }
+
+   cYaepgEpgSnapshot *snapshot = new cYaepgEpgSnapshot(++version);
+   for (const cChannel *chan = Channels->First(); chan != NULL; chan = Channels->Next(chan)) {
+      if (chan->GroupSep()) {
+         continue;
+      }
+      const cSchedule *sched = Schedules->GetSchedule(chan);
+      cYaepgEpgChannel *c = current ? current->Channel(chan) : NULL;
+      if (sched == NULL || sched->Events()->Count() == 0) {
+         /* Keep the cached list until VDR has read its EPG data */
+         if (c != NULL && c->Mapped() && now < loaded + INDEX_CATCHUP) {
+            c->Ref();
+            snapshot->Add(chan, c);
+         }
+         continue;
+      }
+
+      if (c != NULL && c->schedule == sched && Unchanged(c, sched)) {
+         c->Ref();
+      } else {
+         c = BuildChannel(sched, now - INDEX_HISTORY, now);
+         built++;
+      }
+      snapshot->Add(chan, c);
+   }
+
+   cYaepgChannelIndex::Instance()->Publish(new cYaepgChannelViews(Channels, snapshot));
+   Publish(snapshot);
+
+   YAEPG_INFO("EPG index %d, rebuilt %d channels", version, built);
+   return true;
+}
+
+void
+cYaepgEpgIndex::Publish(cYaepgEpgSnapshot *snapshot)
+{
+   cYaepgEpgSnapshot *old;
+
+   mutex.Lock();
+   old = current;
+   current = snapshot;
+   mutex.Unlock();
+
+   if (old != NULL) {
+      old->Unref();
+   }
+}
+
+void
+cYaepgEpgIndex::Action(void)
+{
+   bool pending = false;
+
+   /* Changed() forgets the change it reports, keep it until it's built */
+   while (Running()) {
+      if (stateKeys.Changed(SK_CHANNELS | SK_SCHEDULES)) {
+         pending = true;
+      }
+      if (pending) {
+         pending = !Build();
+      }
+      wakeup.Wait(INDEX_POLL_MS);
+   }
+}
+
+/*
+ * Returns the current snapshot with a reference taken, the caller has to
+ * Unref() it when done.  The first call builds the index right away.
+ */
+const cYaepgEpgSnapshot *
+cYaepgEpgIndex::Acquire(void)
+{
+   mutex.Lock();
+   bool empty = (current == NULL);
+   mutex.Unlock();
+   if (empty) {
+      Build();
+   }
+
+   cMutexLock lock(&mutex);
+   current->Ref();
+   return current;
+}
@@ -0,0 +1,255 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <vdr/channels.h>
+#include <vdr/epg.h>
+#include <vdr/thread.h>
+
+#include "StateKeys.h"
+
+/*
+ *****************************************************************************
+ * tEventSnap
+ *
+ * Copy of the event fields the grid needs, taken while the schedules are
+ * locked.  The grid lays out and draws from these copies only, so it never
+ * holds on to cEvent pointers the EIT thread may delete.  Entries without
+ * EPG data have an id of 0.
+ *****************************************************************************
+ */
+struct tEventSnap {
+   tEventID id;
+   time_t start;
+   int duration;
+   time_t vps;
+   uint16_t flags;
+   std::string title;
+   std::string shortText;
+
+   time_t EndTime(void) const { return start + duration; }
+};
+
+/*
+ * The channel pointer only identifies the channel, everything shown about it
+ * is copied while the channels were locked.
+ */
+struct tSearchHit {
+   const cChannel *chan;
+   int number;
+   std::string chanName;
+   tEventSnap event;
+
+   bool operator<(const tSearchHit &other) const {
+      return event.start != other.event.start ? event.start < other.event.start :
+                                                number < other.number;
+   }
+};
+
+/*
+ *****************************************************************************
+ * cYaepgEpgFile
+ *
+ * The index as saved to the plugin cache directory on shutdown.  The file is
+ * mapped into memory when the plugin starts and used in place until the live
+ * EPG has caught up: header, channel table, event records and word keys are
+ * fixed size records (all multiples of 8 bytes), titles and short texts are
+ * interned in a string pool at the end and referenced by offset.
+ *****************************************************************************
+ */
+#define EPG_FILE_MAGIC           "YAEPGIDX"
+#define EPG_FILE_VERSION         1
+#define EPG_FILE_MAX_SPAN        (62 * SECSINDAY)
+
+struct tEpgFileHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t channels;
+   uint32_t events;
+   uint32_t words;
+   uint32_t strings;
+   uint32_t reserved;
+   int64_t saved;
+};
+
+struct tEpgFileChannel {
+   char id[64];
+   uint32_t firstEvent;
+   uint32_t numEvents;
+   uint32_t firstWord;
+   uint32_t numWords;
+};
+
+struct tEpgFileEvent {
+   int64_t start;
+   int64_t vps;
+   uint32_t id;
+   int32_t duration;
+   uint32_t title;
+   uint32_t shortText;
+   uint16_t flags;
+   uint16_t reserved[3];
+};
+
+class cYaepgEpgFile {
+private:
+   int refs;
+   void *data;
+   size_t size;
+
+   cYaepgEpgFile(void *_data, size_t _size) : refs(1), data(_data), size(_size) {}
+   ~cYaepgEpgFile();
+
+public:
+   static cYaepgEpgFile *Open(const char *name);
+   void Ref(void) { __sync_add_and_fetch(&refs, 1); }
+   void Unref(void) { if (__sync_sub_and_fetch(&refs, 1) == 0) delete this; }
+   const tEpgFileHeader *Header(void) const { return (const tEpgFileHeader *)data; }
+   const tEpgFileChannel *Channels(void) const { return (const tEpgFileChannel *)(Header() + 1); }
+   const tEpgFileEvent *Events(void) const { return (const tEpgFileEvent *)(Channels() + Header()->channels); }
+   const uint64_t *Words(void) const { return (const uint64_t *)(Events() + Header()->events); }
+   const char *String(uint32_t offset) const;
+};
+
+/*
+ *****************************************************************************
+ * cYaepgEpgSnapshot
+ *
+ * Read-only copy of the EPG of all channels.  The events of a channel are
+ * sorted and don't overlap, gaps in the schedule are filled with entries
+ * without EPG data.  Snapshots and the per channel event lists are reference
+ * counted: a new snapshot shares the lists of all channels whose schedule
+ * hasn't changed, and a snapshot stays valid for its readers after a newer
+ * one has been published.  The list of a channel either lives in memory or
+ * in the mapped cache file, readers only go through the accessors.
+ *
+ * The entries of a channel are also bucketed by half hour slot: each slot
+ * holds the first entry ending after the start of the slot.  As the grid
+ * always starts at a full or half hour, finding the first entry of a row is
+ * a single lookup.
+ *
+ * For searching, every channel also has an inverted index of the words in
+ * the titles, short texts and descriptions of its events.  Each entry packs
+ * the hash of a word (upper 32 bits) and the position of the event (lower 32
+ * bits) into one sorted 64 bit key, so all events containing a word are one
+ * equal range and checking a further word of the query is a binary search.
+ *
+ * The channels are keyed by their cChannel, which is never dereferenced
+ * outside the channels lock: the number, id and name of each channel are
+ * copied when it is added to a snapshot.
+ *****************************************************************************
+ */
+class cYaepgEpgChannel {
+private:
+   int refs;
+   cYaepgEpgFile *file;
+   const tEpgFileEvent *fileEvents;
+   const uint64_t *fileWords;
+   int numFileEvents;
+   int numFileWords;
+   time_t slotBase;
+   std::vector< int > slots;
+
+   ~cYaepgEpgChannel();
+
+public:
+   const cSchedule *schedule;
+   time_t modified;
+   time_t built;
+   std::vector< tEventSnap > events;
+   std::vector< uint64_t > words;
+
+   cYaepgEpgChannel(void);
+   cYaepgEpgChannel(cYaepgEpgFile *_file, const tEpgFileChannel &chan);
+   void Ref(void) { __sync_add_and_fetch(&refs, 1); }
+   void Unref(void) { if (__sync_sub_and_fetch(&refs, 1) == 0) delete this; }
+   bool Mapped(void) const { return file != NULL; }
+   int Count(void) const { return file ? numFileEvents : (int)events.size(); }
+   time_t Start(int i) const { return file ? (time_t)fileEvents[i].start : events[i].start; }
+   time_t EndTime(int i) const { return file ? (time_t)(fileEvents[i].start + fileEvents[i].duration) : events[i].EndTime(); }
+   void Get(int i, tEventSnap &snap) const;
+   void BuildSlots(void);
+   int Find(time_t t) const;
+   const uint64_t *Words(void) const { return file ? fileWords : (words.empty() ? NULL : &words[0]); }
+   int NumWords(void) const { return file ? numFileWords : (int)words.size(); }
+};
+
+class cYaepgEpgSnapshot {
+private:
+   struct tSnapChannel {
+      cYaepgEpgChannel *events;
+      int number;
+      tChannelID id;
+      std::string name;
+   };
+   typedef std::map< const cChannel *, tSnapChannel > tChannelMap;
+
+   mutable int refs;
+   int version;
+   tChannelMap channels;
+
+   ~cYaepgEpgSnapshot();
+
+public:
+   cYaepgEpgSnapshot(int _version) : refs(1), version(_version) {}
+   void Ref(void) const { __sync_add_and_fetch(&refs, 1); }
+   void Unref(void) const { if (__sync_sub_and_fetch(&refs, 1) == 0) delete this; }
+   int Version(void) const { return version; }
+   cYaepgEpgChannel *Channel(const cChannel *chan) const;
+   void Add(const cChannel *chan, cYaepgEpgChannel *events);
+   void Row(const cChannel *chan, time_t from, time_t to, std::vector< tEventSnap > &row) const;
+   void Search(const char *query, time_t from, int maxHits, std::vector< tSearchHit > &hits) const;
+   bool Write(const char *name) const;
+};
+
+/*
+ *****************************************************************************
+ * cYaepgEpgIndex
+ *
+ * Background thread keeping a snapshot of the EPG up to date.  Once the
+ * schedules have been modified, the event lists of the channels whose
+ * schedule changed are built again and a new snapshot is published.  Readers
+ * take a reference to the current snapshot and never touch the schedules.
+ * Right after the start the snapshot comes from the cache file, the lists of
+ * channels without live EPG data are kept from it for a few minutes while
+ * VDR is still reading epg.data.
+ *****************************************************************************
+ */
+class cYaepgEpgIndex : public cThread {
+private:
+   static cYaepgEpgIndex *instance;
+
+   cMutex mutex;
+   cMutex buildMutex;
+   cCondWait wakeup;
+   cYaepgEpgSnapshot *current;
+   cYaepgStateKeys stateKeys;
+   time_t loaded;
+   int version;
+
+   cYaepgEpgIndex(void);
+   ~cYaepgEpgIndex();
+   static cYaepgEpgChannel *BuildChannel(const cSchedule *sched, time_t from, time_t now);
+   bool Build(void);
+   void Publish(cYaepgEpgSnapshot *snapshot);
+   void Load(void);
+   void Save(void);
+
+protected:
+   virtual void Action(void);
+
+public:
+   static cYaepgEpgIndex *Instance(void);
+   static void Destroy(void);
+   const cYaepgEpgSnapshot *Acquire(void);
+};
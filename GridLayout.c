@@ -0,0 +1,209 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#include "GridLayout.h"
+
+#include "Utils.h"
+
+#include <vdr/thread.h>
+
+#define FIX_SHIFT                16
+#define FIX_HALF                 (1 << (FIX_SHIFT - 1))
+
+/*
+ *****************************************************************************
+ * cYaepgGridLayout
+ *****************************************************************************
+ */
+cYaepgGridLayout::cYaepgGridLayout(const tGeom &_geom, int _rows, int _rowSpace, int _spanMins, bool _vertical) :
+   geom(_geom),
+   rows(MAX(_rows, 1)),
+   rowSpace(_rowSpace),
+   spanMins(MAX(_spanMins, 1)),
+   vertical(_vertical)
+{
+   int rowStart = vertical ? geom.x : geom.y;
+   int rowLen = vertical ? geom.w : geom.h;
+   int timeLen = vertical ? geom.h : geom.w;
+
+   /*
+    * Each row takes (len + space) / rows pixels including the space after it,
+    * rowPos[rows] marks the end of the last row plus one space so RowSize()
+    * works for every row.
+    */
+   int64_t pitch = ((int64_t)(rowLen + rowSpace) << FIX_SHIFT) / rows;
+   rowPos.resize(rows + 1);
+   for (int i = 0; i <= rows; i++) {
+      rowPos[i] = rowStart + (int)((i * pitch + FIX_HALF) >> FIX_SHIFT);
+   }
+
+   int64_t pixPerMin = ((int64_t)timeLen << FIX_SHIFT) / spanMins;
+   minPos.resize(spanMins + 1);
+   for (int i = 0; i <= spanMins; i++) {
+      minPos[i] = (int)((i * pixPerMin + FIX_HALF) >> FIX_SHIFT);
+   }
+   minPos[spanMins] = timeLen;
+
+   YAEPG_INFO("Grid layout %d rows, %d minutes (%d %d, %d %d)%s",
+              rows, spanMins, geom.x, geom.y, geom.w, geom.h,
+              vertical ? " vertical" : "");
+}
+
+/* Compares against the arguments the way the constructor clamps them */
+bool
+cYaepgGridLayout::Matches(const tGeom &_geom, int _rows, int _rowSpace, int _spanMins, bool _vertical) const
+{
+   return geom.x == _geom.x && geom.y == _geom.y &&
+          geom.w == _geom.w && geom.h == _geom.h &&
+          rows == MAX(_rows, 1) && rowSpace == _rowSpace &&
+          spanMins == MAX(_spanMins, 1) && vertical == _vertical;
+}
+
+/*
+ * The cached layouts, freed when the plugin is unloaded.
+ */
+class cYaepgGridLayoutCache {
+public:
+   cMutex mutex;
+   std::vector< const cYaepgGridLayout * > layouts;
+
+   ~cYaepgGridLayoutCache()
+   {
+      for (int i = 0; i < (int)layouts.size(); i++) {
+         delete layouts[i];
+      }
+   }
+};
+
+const cYaepgGridLayout *
+cYaepgGridLayout::Get(const tGeom &geom, int rows, int rowSpace, int spanMins, bool vertical)
+{
+   static cYaepgGridLayoutCache cache;
+   cMutexLock lock(&cache.mutex);
+
+   for (int i = 0; i < (int)cache.layouts.size(); i++) {
+      if (cache.layouts[i]->Matches(geom, rows, rowSpace, spanMins, vertical)) {
+         return cache.layouts[i];
+      }
+   }
+   cache.layouts.push_back(new cYaepgGridLayout(geom, rows, rowSpace, spanMins, vertical));
+
+   return cache.layouts.back();
+}
+
+int
+cYaepgGridLayout::TimePos(int secs) const
+{
+   int start = vertical ? geom.y : geom.x;
+
+   /* Interpolate between the minute entries for times not on a full minute */
+   int min = secs / 60;
+   int sec = secs % 60;
+
+   if (secs <= 0) {
+      return start + minPos[0];
+   }
+   if (min >= spanMins) {
+      return start + minPos[spanMins];
+   }
+   if (sec == 0) {
+      return start + minPos[min];
+   }
+   return start + minPos[min] + ((minPos[min + 1] - minPos[min]) * sec + 30) / 60;
+}
+
+/* The part of a row between two positions on the time axis */
+tGeom
+cYaepgGridLayout::Rect(int row, int lo, int hi) const
+{
+   tGeom g;
+
+   if (vertical) {
+      g.x = rowPos[row];
+      g.y = lo;
+      g.w = RowSize(row);
+      g.h = hi - lo;
+   } else {
+      g.x = lo;
+      g.y = rowPos[row];
+      g.w = hi - lo;
+      g.h = RowSize(row);
+   }
+   return g;
+}
+
+/* A line of the given thickness across all rows, centered on a time */
+tGeom
+cYaepgGridLayout::Line(int secs, int thick) const
+{
+   tGeom g = geom;
+   int pos = TimePos(secs) - thick / 2;
+
+   if (vertical) {
+      g.y = pos;
+      g.h = thick;
+   } else {
+      g.x = pos;
+      g.w = thick;
+   }
+   return g;
+}
+
+/* The part of g between two positions on the time axis */
+tGeom
+cYaepgGridLayout::Slice(const tGeom &g, int lo, int hi) const
+{
+   tGeom s = g;
+
+   if (vertical) {
+      s.y = lo;
+      s.h = hi - lo;
+   } else {
+      s.x = lo;
+      s.w = hi - lo;
+   }
+   return s;
+}
+
+/*
+ * A thin strip of g between two positions on the time axis, along the
+ * bottom of a horizontal row or the left side of a vertical column.
+ */
+tGeom
+cYaepgGridLayout::Strip(const tGeom &g, int lo, int hi, int thick) const
+{
+   tGeom s = Slice(g, lo, hi);
+
+   if (vertical) {
+      s.w = thick;
+   } else {
+      s.y = g.y + g.h - thick;
+      s.h = thick;
+   }
+   return s;
+}
+
+/* The separator at the end of g on the time axis */
+tGeom
+cYaepgGridLayout::EndEdge(const tGeom &g) const
+{
+   tGeom e;
+
+   if (vertical) {
+      e.x = g.x;
+      e.y = g.y + g.h - 1;
+      e.w = g.w + 1;
+      e.h = 2;
+   } else {
+      e.x = g.x + g.w - 1;
+      e.y = g.y;
+      e.w = 2;
+      e.h = g.h + 1;
+   }
+   return e;
+}
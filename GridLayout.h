@@ -0,0 +1,65 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "GuiElements.h"
+
+/*
+ *****************************************************************************
+ * cYaepgGridLayout
+ *
+ * Integer lookup tables for the grid geometry.  The row positions and the
+ * pixel offset of every minute in the visible time span are computed once in
+ * 16.16 fixed point, so all widgets placing things on the grid get the same,
+ * consistently rounded positions without any floating point math.  Layouts
+ * are cached per geometry, row count, time span and orientation (i.e. per
+ * theme and zoom level) for the lifetime of the plugin.
+ *
+ * The tables are kept per axis rather than per x/y: a "row" is a channel
+ * band and time runs along the other axis.  Horizontal layouts have time
+ * running along x, vertical ones have time running downward with the
+ * channels as columns.  Widgets ask for rectangles in these terms and never
+ * look at the orientation themselves.
+ *****************************************************************************
+ */
+class cYaepgGridLayout {
+private:
+   tGeom geom;
+   int rows;
+   int rowSpace;
+   int spanMins;
+   bool vertical;
+   std::vector< int > rowPos;
+   std::vector< int > minPos;
+
+   cYaepgGridLayout(const tGeom &_geom, int _rows, int _rowSpace, int _spanMins, bool _vertical);
+   bool Matches(const tGeom &_geom, int _rows, int _rowSpace, int _spanMins, bool _vertical) const;
+
+public:
+   static const cYaepgGridLayout *Get(const tGeom &geom, int rows, int rowSpace, int spanMins, bool vertical = false);
+   bool Vertical(void) const { return vertical; }
+   int Rows(void) const { return rows; }
+   int SpanMins(void) const { return spanMins; }
+   int RowPos(int row) const { return rowPos[row]; }
+   int RowSize(int row) const { return rowPos[row + 1] - rowPos[row] - rowSpace; }
+   int TimePos(int secs) const;
+   int Lo(const tGeom &g) const { return vertical ? g.y : g.x; }
+   int Hi(const tGeom &g) const { return vertical ? g.y + g.h : g.x + g.w; }
+   tGeom Rect(int row, int lo, int hi) const;
+   tGeom Cell(int row, int secFrom, int secTo) const { return Rect(row, TimePos(secFrom), TimePos(secTo)); }
+   tGeom Band(int row) const { return Cell(row, 0, spanMins * 60); }
+   tGeom Before(int row, int size) const { return Rect(row, TimePos(0) - size, TimePos(0)); }
+   tGeom After(int row, int size) const { return Rect(row, TimePos(spanMins * 60), TimePos(spanMins * 60) + size); }
+   tGeom Line(int secs, int thick) const;
+   tGeom Slice(const tGeom &g, int lo, int hi) const;
+   tGeom Strip(const tGeom &g, int lo, int hi, int thick) const;
+   tGeom EndEdge(const tGeom &g) const;
+};
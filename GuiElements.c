@@ -8,6 +8,11 @@
 
 #include "GuiElements.h"
 
+#include "EpgIndex.h"
+#include "GridLayout.h"
+#include "ImageIndex.h"
+#include "LogoAtlas.h"
+#include "TimerIndex.h"
 #include "Utils.h"
 #include "ServiceStructs.h"
 #include "MenuSetupYaepg.h"
@@ -55,6 +60,25 @@ void cFontSymbols::InitCharSet()
   }
 }
 
+/*
+ * Copy the pixels of a rectangle given in OSD coordinates from one bitmap to
+ * another, used to restore parts of the screen without redrawing it all.
+ */
+void
+CopyBitmapRect(cBitmap *dst, const cBitmap *src, const tGeom &g)
+{
+   int x1 = MAX(g.x, src->X0());
+   int y1 = MAX(g.y, src->Y0());
+   int x2 = MIN(g.x + g.w, src->X0() + src->Width());
+   int y2 = MIN(g.y + g.h, src->Y0() + src->Height());
+
+   for (int y = y1; y < y2; y++) {
+      for (int x = x1; x < x2; x++) {
+         dst->DrawPixel(x, y, src->GetColor(x - src->X0(), y - src->Y0()));
+      }
+   }
+}
+
 
 /*
  *****************************************************************************
@@ -63,6 +87,9 @@ void cFontSymbols::InitCharSet()
  */
 
 cYaepgTheme *cYaepgTheme::instance = NULL;
+cMutex cYaepgTheme::useMutex;
+int cYaepgTheme::guides = 0;
+bool cYaepgTheme::benchmark = false;
 
 cYaepgTheme::cYaepgTheme(void)
 {
@@ -85,6 +112,20 @@ cYaepgTheme::cYaepgTheme(void)
    AddElement("gridSelFg", THEME_COLOR);
    AddElement("gridSelBg", THEME_COLOR);
    AddElement("gridSepColor", THEME_COLOR);
+   AddElement("gridBadgeColor", THEME_COLOR);
+   AddElement("gridNowColor", THEME_COLOR);
+   AddElement("gridProgressColor", THEME_COLOR);
+   AddElement("gridGenreMovieBg", THEME_COLOR);
+   AddElement("gridGenreNewsBg", THEME_COLOR);
+   AddElement("gridGenreShowBg", THEME_COLOR);
+   AddElement("gridGenreSportsBg", THEME_COLOR);
+   AddElement("gridGenreChildrenBg", THEME_COLOR);
+   AddElement("gridGenreMusicBg", THEME_COLOR);
+   AddElement("gridGenreArtsBg", THEME_COLOR);
+   AddElement("gridGenreSocialBg", THEME_COLOR);
+   AddElement("gridGenreEducationBg", THEME_COLOR);
+   AddElement("gridGenreLeisureBg", THEME_COLOR);
+   AddElement("gridGenreSpecialBg", THEME_COLOR);
    AddElement("gridChanColor", THEME_COLOR);
    AddElement("gridTimeColor", THEME_COLOR);
    AddElement("gridDateColor", THEME_COLOR);
@@ -110,6 +151,8 @@ cYaepgTheme::cYaepgTheme(void)
    AddElement("vidWinGeom", THEME_GEOM);
    AddElement("helpGeom", THEME_GEOM);
    AddElement("gridHorizSpace", THEME_IVAL);
+   AddElement("gridProgressHeight", THEME_IVAL);
+   AddElement("gridVertical", THEME_IVAL);
    AddElement("gridNumChans", THEME_IVAL);
    AddElement("leftArrowWidth", THEME_IVAL);
    AddElement("rightArrowWidth", THEME_IVAL);
@@ -145,6 +188,38 @@ cYaepgTheme::Instance(void)
    return instance;
 }
 
+/*
+ * Any number of guides may share the theme, an exclusive user (the benchmark)
+ * only gets it while no guide is open.
+ */
+bool
+cYaepgTheme::Acquire(bool exclusive)
+{
+   cMutexLock lock(&useMutex);
+
+   if (benchmark || (exclusive && guides > 0)) {
+      return false;
+   }
+   if (exclusive) {
+      benchmark = true;
+   } else {
+      guides++;
+   }
+   return true;
+}
+
+void
+cYaepgTheme::Release(bool exclusive)
+{
+   cMutexLock lock(&useMutex);
+
+   if (exclusive) {
+      benchmark = false;
+   } else {
+      guides--;
+   }
+}
+
 void
 cYaepgTheme::Destroy(void)
 {
@@ -234,6 +309,12 @@ cYaepgTheme::Load(std::string Theme)
 
    snprintf(themeFile, sizeof(themeFile), "%s/%s.theme", sThemeDir.c_str(), Theme.c_str());
 
+   /* Forget the values of a previously loaded theme */
+   std::map< std::string, tThemeElement >::iterator it;
+   for (it = themeMap.begin(); it != themeMap.end(); it++) {
+      it->second.init = false;
+   }
+
    fp = fopen(themeFile, "r");
    if (fp == NULL) {
       YAEPG_ERROR("Could not open teme file: %s", Theme.c_str());
@@ -500,7 +581,6 @@ cYaepgTextBox::cYaepgTextBox(void) :
    fgColor(clrTransparent),
    bgColor(clrTransparent),
    bgImage(NULL),
-   bitmap(NULL),
    flags((eTextFlags)0)
 {
    geom.x = 0;
@@ -655,33 +735,1192 @@ out:
       yOff += yDelta;
    }
 
-   free(tokText);
+   free(tokText);
+
+   return;
+}
+
+void
+cYaepgTextBox::Offset(int dx, int dy)
+{
+   /* Move an already generated box without laying out the text again */
+   geom.x += dx;
+   geom.y += dy;
+   for (int i = 0; i < (int)fmtText.size(); i++) {
+      fmtText[i].geom.x += dx;
+      fmtText[i].geom.y += dy;
+   }
+}
+
+void
+cYaepgTextBox::Swap(cYaepgTextBox &other)
+{
+   text.swap(other.text);
+   fmtText.swap(other.fmtText);
+   std::swap(font, other.font);
+   std::swap(fgColor, other.fgColor);
+   std::swap(bgColor, other.bgColor);
+   std::swap(bgImage, other.bgImage);
+   std::swap(flags, other.flags);
+   std::swap(geom, other.geom);
+}
+
+void
+cYaepgTextBox::Draw(cBitmap *bmp)
+{
+   YAEPG_INFO("Drawing text box (%d)", fmtText.size());
+
+   for (int i = 0; i < (int)fmtText.size(); i++) {
+      /* Fill in background color */
+      if (bgColor != clrTransparent) {
+         bmp->DrawRectangle(geom.x, geom.y,
+                            geom.x + (geom.w - 1), geom.y + (geom.h - 1),
+                            bgColor);
+      }
+
+      /* Draw the text */
+      YAEPG_INFO("Drawing text '%s' at (%d %d color #%08X",
+                 fmtText[i].text.c_str(), fmtText[i].geom.x,
+                 fmtText[i].geom.y, fgColor);
+      YAEPG_INFO("Text widht %d box widht %d",
+                 font->Width(fmtText[i].text.c_str()), geom.w);
+
+      bmp->DrawText(fmtText[i].geom.x, fmtText[i].geom.y,
+                    fmtText[i].text.c_str(), fgColor, bgColor, font);
+   }
+}
+
+
+
+/*
+ *****************************************************************************
+ * cYaepgGridCells
+ *****************************************************************************
+ */
+void
+cYaepgGridCells::Reserve(int rows, int cellsPerRow)
+{
+   rowStart.reserve(rows);
+   geoms.reserve(rows * cellsPerRow);
+   flags.reserve(rows * cellsPerRow);
+   events.reserve(rows * cellsPerRow);
+}
+
+void
+cYaepgGridCells::Clear(void)
+{
+   /*
+    * clear() keeps the capacity of the vectors.  The layout store is never
+    * shrunk so that the text boxes can reuse their string/line buffers.
+    */
+   rowStart.clear();
+   rowChans.clear();
+   geoms.clear();
+   flags.clear();
+   events.clear();
+   numCells = 0;
+}
+
+void
+cYaepgGridCells::Swap(cYaepgGridCells &other)
+{
+   rowStart.swap(other.rowStart);
+   rowChans.swap(other.rowChans);
+   geoms.swap(other.geoms);
+   flags.swap(other.flags);
+   events.swap(other.events);
+   boxes.swap(other.boxes);
+   std::swap(numCells, other.numCells);
+}
+
+int
+cYaepgGridCells::AddCell(const tEventSnap &event, uint16_t cellFlags, const tGeom &geom)
+{
+   ASSERT(rowStart.size() > 0);
+
+   geoms.push_back(geom);
+   flags.push_back(cellFlags);
+   events.push_back(event);
+   if (numCells >= (int)boxes.size()) {
+      boxes.resize(numCells + 1);
+   }
+
+   return numCells++;
+}
+
+int
+cYaepgGridCells::FindRow(const cChannel *chan) const
+{
+   for (int i = 0; i < (int)rowChans.size(); i++) {
+      if (rowChans[i] == chan) {
+         return i;
+      }
+   }
+   return -1;
+}
+
+void
+cYaepgGridCells::TakeRow(cYaepgGridCells &from, int row, int dx, int dy)
+{
+   AddRow(from.rowChans[row]);
+   for (int n = from.First(row); n < from.End(row); n++) {
+      tGeom g = from.geoms[n];
+      g.x += dx;
+      g.y += dy;
+      int c = AddCell(from.events[n], from.flags[n], g);
+      boxes[c].Swap(from.boxes[n]);
+      boxes[c].Offset(dx, dy);
+   }
+
+   /* The layout has been moved out, make sure it isn't taken twice */
+   from.rowChans[row] = NULL;
+}
+
+int
+cYaepgGridCells::ColAt(int row, int pos, const cYaepgGridLayout *layout) const
+{
+   int first = First(row);
+   int end = End(row);
+
+   /* Cells of a row are sorted by time and don't overlap */
+   for (int i = first; i < end; i++) {
+      if (pos < layout->Hi(geoms[i])) {
+         return i - first;
+      }
+   }
+   return end - first - 1;
+}
+
+
+
+/*
+ *****************************************************************************
+ * cYaepgGrid
+ *****************************************************************************
+ */
+
+/*
+ * Theme colors indexed by the content nibble of the event (EN 300 468
+ * content descriptor level 1), undefined and user defined genres stay
+ * transparent.
+ */
+static const char *genreColors[CELL_GENRES] = {
+   NULL,
+   "gridGenreMovieBg",
+   "gridGenreNewsBg",
+   "gridGenreShowBg",
+   "gridGenreSportsBg",
+   "gridGenreChildrenBg",
+   "gridGenreMusicBg",
+   "gridGenreArtsBg",
+   "gridGenreSocialBg",
+   "gridGenreEducationBg",
+   "gridGenreLeisureBg",
+   "gridGenreSpecialBg",
+   NULL,
+   NULL,
+   NULL,
+   NULL
+};
+
+/*
+ *****************************************************************************
+ * tSelEvent
+ *****************************************************************************
+ */
+tSelEvent::tSelEvent(void)
+{
+   event.id = 0;
+   event.start = 0;
+   event.duration = 0;
+   event.vps = 0;
+   event.flags = 0;
+}
+
+const cEvent *
+tSelEvent::Find(const cSchedules *Schedules) const
+{
+   const cSchedule *sched = (Schedules && event.id) ? Schedules->GetSchedule(channel) : NULL;
+
+   return sched ? sched->GetEvent(event.id) : NULL;
+}
+
+bool
+tSelEvent::Same(const tSelEvent &other) const
+{
+   return channel == other.channel && event.id == other.event.id &&
+          event.start == other.event.start && event.duration == other.event.duration &&
+          event.title == other.event.title && description == other.description;
+}
+
+/*
+ * Copies an entry of a view for the event widgets, adding the description
+ * which the index doesn't keep.
+ */
+static tSelEvent
+SelectEvent(const tChannelID &channel, const tEventSnap &snap)
+{
+   tSelEvent sel;
+
+   sel.event = snap;
+   if (snap.id == 0 || !channel.Valid()) {
+      sel.event.title.assign(tr("No Info"));
+      sel.description.assign(tr("No Info"));
+      return sel;
+   }
+
+   YAEPG_SCHEDULES_READ;
+   sel.channel = channel;
+   const cEvent *e = sel.Find(Schedules);
+   if (e != NULL && e->Description() != NULL) {
+      sel.description.assign(e->Description());
+   }
+   return sel;
+}
+
+static tSelEvent
+SelectEvent(const cChannel *chan, const tEventSnap &snap)
+{
+   return SelectEvent(chan ? chan->GetChannelID() : tChannelID::InvalidID, snap);
+}
+
+cYaepgGrid::cYaepgGrid(std::vector< const cChannel * > &chans, int time) :
+   startTime(time),
+   chanVec(chans),
+   cacheStart(0),
+   cacheVersion(-1),
+   badgeVersion(-1),
+   nowTime(0),
+   curX(0),
+   curY(0)
+{
+   geom = GRID_EVENT_GEOM;
+   layout = cYaepgGridLayout::Get(geom, chanVec.size(), GRID_HORIZ_SPACE, 90, GRID_VERTICAL);
+   rowSnaps.resize(chanVec.size());
+   cells.Reserve(chanVec.size(), 8);
+   prevCells.Reserve(chanVec.size(), 8);
+   leftArrows.resize(chanVec.size());
+   rightArrows.resize(chanVec.size());
+   InitBadges();
+   InitGenres();
+   Generate();
+}
+
+void
+cYaepgGrid::FixCursor(void)
+{
+   if (curY < 0) {
+      curY = 0;
+   }
+   if (curY >= cells.Rows()) {
+      curY = cells.Rows() - 1;
+   }
+
+   if (curX < 0) {
+      curX = 0;
+   }
+   if (curX >= cells.Cols(curY)) {
+      curX = cells.Cols(curY) - 1;
+   }
+}
+
+void
+cYaepgGrid::InitBadges(void)
+{
+   bool symbols = iInfoSymbols && iVDRSymbols;
+
+   /* Badge text for each combination of the badge flags */
+   for (int i = 0; i < CELL_BADGE_COMBOS; i++) {
+      uint16_t f = i << CELL_BADGE_SHIFT;
+
+      badgeText[i].clear();
+      if (f & CELL_RECORDING) {
+         badgeText[i].append(symbols ? cFontSymbols::Recording() : "R");
+      } else if (f & CELL_TIMER) {
+         badgeText[i].append(symbols ? cFontSymbols::Watch() : "T");
+      } else if (f & CELL_TIMER_PARTIAL) {
+         badgeText[i].append(symbols ? cFontSymbols::WatchUpperHalf() : "t");
+      }
+      if (f & CELL_VPS) {
+         badgeText[i].append(symbols ? cFontSymbols::VPS() : "V");
+      }
+      badgeWidth[i] = badgeText[i].empty() ? 0 : GRID_EVENT_FONT->Width(badgeText[i].c_str()) + TEXT_BORDER;
+   }
+}
+
+void
+cYaepgGrid::InitGenres(void)
+{
+   for (int i = 0; i < CELL_GENRES; i++) {
+      if (genreColors[i] != NULL && THEME_INIT(genreColors[i])) {
+         genreBg[i] = THEME_COLOR(genreColors[i]);
+      } else {
+         genreBg[i] = clrTransparent;
+      }
+   }
+}
+
+int
+cYaepgGrid::BadgeWidth(int cell)
+{
+   int w = badgeWidth[(cells.Flags(cell) & CELL_BADGES) >> CELL_BADGE_SHIFT];
+
+   /* Don't let the badges eat up the whole cell */
+   return (cells.Geom(cell).w > 2 * w) ? w : 0;
+}
+
+void
+cYaepgGrid::UpdateBadges(void)
+{
+   time_t gridStart = startTime - (startTime % 1800);
+   int version = cYaepgTimerIndex::Instance()->Update(gridStart, gridStart + 5400);
+
+   /* Only join again if the grid or the timers have changed */
+   if (version == badgeVersion) {
+      return;
+   }
+   badgeVersion = version;
+
+   for (int i = 0; i < cells.Rows(); i++) {
+      cYaepgTimerIndex::Instance()->Join(cells.RowChan(i), cells.RowEvents(i),
+                                         cells.Cols(i), cells.RowFlags(i));
+
+      /* Lay out the text again where the space taken by badges changed */
+      for (int n = cells.First(i); n < cells.End(i); n++) {
+         cYaepgTextBox &box = cells.Box(n);
+         int w = cells.Geom(n).w - BadgeWidth(n);
+         if (box.W() != w) {
+            box.W(w);
+            box.Generate();
+         }
+      }
+   }
+}
+
+void
+cYaepgGrid::Row(int row)
+{
+   curY = row;
+   FixCursor();
+}
+
+void
+cYaepgGrid::Col(int col)
+{
+   curX = col;
+   FixCursor();
+}
+
+void
+cYaepgGrid::Select(int row, time_t t)
+{
+   curY = row;
+   FixCursor();
+   curX = cells.ColAt(curY, TimePos(t), layout);
+}
+
+void
+cYaepgGrid::GenerateRow(int row, const std::vector< tEventSnap > &snaps, time_t gridStart)
+{
+   time_t endTime;
+   time_t evStart, evDuration;
+   uint16_t evFlags;
+   tGeom cellGeom;
+
+   endTime = gridStart + 5400;
+   cells.AddRow(chanVec[row]);
+
+   for (int i = 0; i < (int)snaps.size(); i++) {
+      const tEventSnap &snap = snaps[i];
+
+      evFlags = snap.flags;
+      evStart = snap.start;
+      evDuration = snap.duration;
+      if (evStart < gridStart) {
+         evFlags |= CELL_ARROW_LEFT;
+         evStart = gridStart;
+         evDuration -= gridStart - snap.start;
+      }
+      if ((evStart + evDuration) > endTime) {
+         evFlags |= CELL_ARROW_RIGHT;
+         evDuration = endTime - evStart;
+      }
+
+      ASSERT(evDuration <= 5400);
+      ASSERT(evStart + evDuration <= endTime);
+
+      cellGeom = layout->Cell(row, evStart - gridStart, evStart + evDuration - gridStart);
+
+      int n = cells.AddCell(snap, evFlags, cellGeom);
+      cYaepgTextBox &box = cells.Box(n);
+      box.Text(snap.title.c_str());
+      box.Font(GRID_EVENT_FONT);
+      box.FgColor(GRID_EVENT_COLOR);
+      box.BgColor(clrTransparent);
+      box.Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
+      box.X(cellGeom.x);
+      box.Y(cellGeom.y);
+      box.W(cellGeom.w);
+      box.H(cellGeom.h);
+      box.Generate();
+
+      YAEPG_INFO("Event [%d][%d] (%d %d, %d %d) '%s'", row, n - cells.First(row),
+                 cellGeom.x, cellGeom.y, cellGeom.w, cellGeom.h,
+                 snap.title.c_str());
+   }
+}
+
+void
+cYaepgGrid::Generate(void)
+{
+   YAEPG_INFO("Generating grid");
+
+   time_t gridStart = startTime - (startTime % 1800);
+   int generated = 0;
+
+   /*
+    * Rows are cached by channel.  As long as the time window and the EPG
+    * data haven't changed, rows of channels that were already visible are
+    * moved over from the previous generation and only the rows that scrolled
+    * into view are built from the schedules.
+    */
+   const cYaepgEpgSnapshot *epg = cYaepgEpgIndex::Instance()->Acquire();
+   bool reuse = (gridStart == cacheStart && epg->Version() == cacheVersion);
+
+   /*
+    * On the minute tick or when the grid is shown again after another view,
+    * the whole layout is kept if neither the window, the channels nor any of
+    * VDR's lists have changed since.
+    */
+   if (!stateKeys.Changed() && reuse && chanVec == cacheChans) {
+      epg->Unref();
+      nowTime = time(NULL);
+      YAEPG_INFO("Grid unchanged");
+      return;
+   }
+   cacheStart = gridStart;
+   cacheVersion = epg->Version();
+   cacheChans = chanVec;
+   prevCells.Swap(cells);
+   cells.Clear();
+
+   /*
+    * The events come from the EPG index, the schedules aren't touched here.
+    * Small channel views repeat channels to fill the grid, so a previous row
+    * is looked up only after the rows above have taken theirs: each copy of
+    * a channel gets a row of its own or is built again.
+    */
+   rowSnaps.resize(chanVec.size());
+   for (int i = 0; i < (int)chanVec.size(); i++) {
+      int prevRow = reuse ? prevCells.FindRow(chanVec[i]) : -1;
+      if (prevRow >= 0) {
+         /* The first cell of a row always starts at the beginning of the band */
+         tGeom band = layout->Band(i);
+         const tGeom &prev = prevCells.Geom(prevCells.First(prevRow));
+         cells.TakeRow(prevCells, prevRow, band.x - prev.x, band.y - prev.y);
+      } else {
+         epg->Row(chanVec[i], gridStart, gridStart + 5400, rowSnaps[i]);
+         GenerateRow(i, rowSnaps[i], gridStart);
+         generated++;
+      }
+
+      /*
+       * Generate the arrows, before and after the time span of the row
+       * XXX Most of the arrow initialization could be done once when the grid is constructed
+       */
+      bool vertical = layout->Vertical();
+      tGeom before = layout->Before(i, LEFT_ARROW_WIDTH);
+      tGeom after = layout->After(i, RIGHT_ARROW_WIDTH);
+
+      leftArrows[i].Text((cells.Flags(cells.First(i)) & CELL_ARROW_LEFT) ? (vertical ? "^" : "<") : "");
+      leftArrows[i].Font(GRID_EVENT_FONT);
+      leftArrows[i].FgColor(GRID_EVENT_COLOR);
+      leftArrows[i].BgColor(clrTransparent);
+      leftArrows[i].Flags(vertical ? (eTextFlags)(TBOX_VALIGN_CENTER | TBOX_HALIGN_BOTTOM) :
+                                     (eTextFlags)(TBOX_VALIGN_RIGHT | TBOX_HALIGN_CENTER));
+      leftArrows[i].X(before.x);
+      leftArrows[i].Y(before.y);
+      leftArrows[i].W(before.w);
+      leftArrows[i].H(before.h);
+      leftArrows[i].Generate();
+
+      rightArrows[i].Text((cells.Flags(cells.End(i) - 1) & CELL_ARROW_RIGHT) ? (vertical ? "v" : ">") : "");
+      rightArrows[i].Font(GRID_EVENT_FONT);
+      rightArrows[i].FgColor(GRID_EVENT_COLOR);
+      rightArrows[i].BgColor(clrTransparent);
+      rightArrows[i].Flags(vertical ? (eTextFlags)(TBOX_VALIGN_CENTER | TBOX_HALIGN_TOP) :
+                                      (eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
+      rightArrows[i].X(after.x);
+      rightArrows[i].Y(after.y);
+      rightArrows[i].W(after.w);
+      rightArrows[i].H(after.h);
+      rightArrows[i].Generate();
+   }
+
+   epg->Unref();
+
+   YAEPG_INFO("Generated %d of %d rows", generated, (int)chanVec.size());
+
+   nowTime = time(NULL);
+   badgeVersion = -1;
+   UpdateBadges();
+   FixCursor();
+}
+
+bool
+cYaepgGrid::MoveCursor(eCursorDir dir)
+{
+   const tGeom &cur = cells.Geom(cells.Index(curY, curX));
+   int mid = (layout->Lo(cur) + layout->Hi(cur)) / 2;
+
+   switch (dir) {
+   case DIR_UP:
+      if (curY == 0) {
+         return false;
+      }
+      curY--;
+      /* Stay at the same time when moving between rows */
+      curX = cells.ColAt(curY, mid, layout);
+      break;
+   case DIR_DOWN:
+      if (curY == cells.Rows() - 1) {
+         return false;
+      }
+      curY++;
+      curX = cells.ColAt(curY, mid, layout);
+      break;
+   case DIR_LEFT:
+      if (curX == 0) {
+         return false;
+      }
+      curX--;
+      break;
+   case DIR_RIGHT:
+      if (curX == cells.Cols(curY) - 1) {
+         return false;
+      }
+      curX++;
+      break;
+   default:
+      ASSERT(0);
+      break;
+   }
+
+   ASSERT(curY >= 0 && curY < cells.Rows());
+   ASSERT(curX >= 0 && curX < cells.Cols(curY));
+
+   return true;
+}
+
+bool
+cYaepgGrid::Vertical(void)
+{
+   return layout->Vertical();
+}
+
+int
+cYaepgGrid::TimePos(time_t t)
+{
+   time_t gridStart = startTime - (startTime % 1800);
+   int secOff = MIN(MAX(t - gridStart, 0), 5400);
+
+   return layout->TimePos(secOff);
+}
+
+bool
+cYaepgGrid::Running(int cell, time_t t)
+{
+   const tEventSnap &e = cells.Event(cell);
+
+   return e.id != 0 && e.start <= t && t < e.EndTime();
+}
+
+/*
+ * The cells only hold copies, the description is looked up when the cell is
+ * selected.
+ */
+tSelEvent
+cYaepgGrid::Event(void)
+{
+   return SelectEvent(cells.RowChan(curY), cells.Event(cells.Index(curY, curX)));
+}
+
+bool
+cYaepgGrid::NowGeom(tGeom &g)
+{
+   time_t gridStart = startTime - (startTime % 1800);
+
+   if (nowTime < gridStart || nowTime >= gridStart + 5400) {
+      return false;
+   }
+   g = layout->Line(nowTime - gridStart, 2);
+   return true;
+}
+
+void
+cYaepgGrid::DrawCell(cBitmap *bmp, int cell, bool sel)
+{
+   cYaepgTextBox &box = cells.Box(cell);
+   const tGeom &g = cells.Geom(cell);
+   tColor bg = genreBg[(cells.Flags(cell) & CELL_GENRE) >> CELL_GENRE_SHIFT];
+
+   /* Is this the currently selected event */
+   if (sel) {
+      bg = GRID_SEL_BG;
+      box.FgColor(GRID_SEL_FG);
+   } else {
+      box.FgColor(GRID_EVENT_COLOR);
+   }
+   box.BgColor(bg);
+   box.Draw(bmp);
+
+   /* Timer, recording and VPS badges at the right end of the cell */
+   int bw = BadgeWidth(cell);
+   if (bw) {
+      const std::string &badge = badgeText[(cells.Flags(cell) & CELL_BADGES) >> CELL_BADGE_SHIFT];
+      cFont *font = GRID_EVENT_FONT;
+      if (bg != clrTransparent) {
+         bmp->DrawRectangle(g.x + g.w - bw, g.y, g.x + g.w - 1, g.y + g.h - 1, bg);
+      }
+      bmp->DrawText(g.x + g.w - bw, g.y + (g.h - font->Height()) / 2,
+                    badge.c_str(), sel ? GRID_SEL_FG : GRID_BADGE_COLOR,
+                    clrTransparent, font);
+   }
+
+   /* Progress of a running event along the edge of the cell */
+   if (Running(cell, nowTime)) {
+      int lo = layout->Lo(g);
+      int hi = MIN(TimePos(nowTime), layout->Hi(g) - 1);
+      if (hi > lo) {
+         tGeom p = layout->Strip(g, lo, hi, GRID_PROGRESS_HEIGHT);
+         bmp->DrawRectangle(p.x, p.y, p.x + p.w - 1, p.y + p.h - 1, GRID_PROGRESS_COLOR);
+      }
+   }
+
+   DrawSeparator(bmp, cell);
+}
+
+void
+cYaepgGrid::DrawSeparator(cBitmap *bmp, int cell)
+{
+   /* Draw a separator if there is no right arrow */
+   if ((cells.Flags(cell) & CELL_ARROW_RIGHT) == 0) {
+      tGeom e = layout->EndEdge(cells.Geom(cell));
+
+      YAEPG_INFO("Drawing separator at (%d %d, %d %d)",
+                 e.x, e.y, e.x + e.w - 1, e.y + e.h - 1);
+
+      bmp->DrawRectangle(e.x, e.y, e.x + e.w - 1, e.y + e.h - 1, GRID_SEP_COLOR);
+   }
+}
+
+static tGeom
+UnionGeom(const tGeom &a, const tGeom &b)
+{
+   tGeom u;
+
+   u.x = MIN(a.x, b.x);
+   u.y = MIN(a.y, b.y);
+   u.w = MAX(a.x + a.w, b.x + b.w) - u.x;
+   u.h = MAX(a.y + a.h, b.y + b.h) - u.y;
+   return u;
+}
+
+/*
+ * Minute tick: advance the progress fills of the running events in bmp and
+ * collect the rectangles that changed.  Only cells of events that stopped
+ * running are drawn again as a whole.
+ */
+void
+cYaepgGrid::Tick(time_t now, cBitmap *bmp, std::vector< tGeom > &dirty)
+{
+   time_t prevTime = nowTime;
+   int prevPos = TimePos(prevTime);
+   int nowPos = TimePos(now);
+   int ph = GRID_PROGRESS_HEIGHT;
+
+   nowTime = now;
+   for (int i = 0; i < cells.Rows(); i++) {
+      int sel = (i == curY) ? cells.Index(curY, curX) : -1;
+
+      for (int n = cells.First(i); n < cells.End(i); n++) {
+         const tGeom &g = cells.Geom(n);
+         bool wasRunning = Running(n, prevTime);
+
+         if (wasRunning && !Running(n, now)) {
+            /* Restore the background including the separators on both sides */
+            tGeom r = g;
+            if (n > cells.First(i)) {
+               r = UnionGeom(r, layout->EndEdge(cells.Geom(n - 1)));
+            }
+            if ((cells.Flags(n) & CELL_ARROW_RIGHT) == 0) {
+               r = UnionGeom(r, layout->EndEdge(g));
+            }
+            CopyBitmapRect(bmp, BG_IMAGE, r);
+            if (n > cells.First(i)) {
+               DrawSeparator(bmp, n - 1);
+            }
+            DrawCell(bmp, n, n == sel);
+            dirty.push_back(r);
+         } else if (Running(n, now)) {
+            int lo = wasRunning ? MAX(prevPos, layout->Lo(g)) : layout->Lo(g);
+            int hi = MIN(nowPos, layout->Hi(g) - 1);
+            if (hi > lo) {
+               tGeom p = layout->Strip(g, lo, hi, ph);
+               bmp->DrawRectangle(p.x, p.y, p.x + p.w - 1, p.y + p.h - 1, GRID_PROGRESS_COLOR);
+               dirty.push_back(p);
+            }
+         }
+      }
+   }
+}
+
+void
+cYaepgGrid::Draw(cBitmap *bmp)
+{
+   YAEPG_INFO("Drawing grid at (%d %d)", geom.x, geom.y);
+
+   for (int i = 0; i < cells.Rows(); i++) {
+      int first = cells.First(i);
+      int end = cells.End(i);
+      int sel = (i == curY) ? cells.Index(curY, curX) : -1;
+
+      for (int n = first; n < end; n++) {
+         DrawCell(bmp, n, n == sel);
+      }
+
+      /* Draw the arrow boxes, "selected" along with the first/last cell */
+      if (sel == first) {
+         leftArrows[i].FgColor(GRID_SEL_FG);
+         leftArrows[i].BgColor(GRID_SEL_BG);
+      } else {
+         leftArrows[i].FgColor(GRID_EVENT_COLOR);
+         leftArrows[i].BgColor(clrTransparent);
+      }
+      leftArrows[i].Draw(bmp);
+
+      if (sel == end - 1 && (cells.Flags(sel) & CELL_ARROW_RIGHT)) {
+         rightArrows[i].FgColor(GRID_SEL_FG);
+         rightArrows[i].BgColor(GRID_SEL_BG);
+      } else {
+         rightArrows[i].FgColor(GRID_EVENT_COLOR);
+         rightArrows[i].BgColor(clrTransparent);
+      }
+      rightArrows[i].Draw(bmp);
+   } /* for i < cells.Rows() */
+}
+
+
+/*
+ *****************************************************************************
+ * cYaepgWeekView
+ *****************************************************************************
+ */
+cYaepgWeekView::cYaepgWeekView(std::vector< const cChannel * > &chans, int _slotTime) :
+   chanVec(chans),
+   slotTime(_slotTime),
+   curX(0),
+   curY(0)
+{
+   geom = GRID_EVENT_GEOM;
+   layout = cYaepgGridLayout::Get(geom, chanVec.size(), GRID_HORIZ_SPACE, WEEK_DAYS, GRID_VERTICAL);
+   dayLayout = cYaepgGridLayout::Get(GRID_TIME_GEOM, 1, 0, WEEK_DAYS, GRID_VERTICAL);
+   Generate();
+}
+
+/*
+ * Each slot gets the index entry covering its start, a slot in a gap of the
+ * schedule comes out as a "No Info" entry.
+ */
+void
+cYaepgWeekView::FillRow(int row, const cYaepgEpgSnapshot *epg)
+{
+   std::vector< tEventSnap > slot;
+
+   for (int d = 0; d < WEEK_DAYS; d++) {
+      epg->Row(chanVec[row], slots[d], slots[d] + 1, slot);
+      events[row * WEEK_DAYS + d] = slot[0];
+   }
+}
+
+tSelEvent
+cYaepgWeekView::Event(void)
+{
+   return SelectEvent(chanVec[curY], events[curY * WEEK_DAYS + curX]);
+}
+
+void
+cYaepgWeekView::Generate(void)
+{
+   time_t now = time(NULL);
+   struct tm locTime;
+   char dayStr[32];
+   int rows = chanVec.size();
+
+   YAEPG_INFO("Generating week view at %02d:%02d", slotTime / 100, slotTime % 100);
+
+   /* mktime() takes care of month ends and daylight saving changes */
+   for (int d = 0; d < WEEK_DAYS; d++) {
+      localtime_r(&now, &locTime);
+      locTime.tm_mday += d;
+      locTime.tm_hour = slotTime / 100;
+      locTime.tm_min = slotTime % 100;
+      locTime.tm_sec = 0;
+      locTime.tm_isdst = -1;
+      slots[d] = mktime(&locTime);
+
+      tGeom g = dayLayout->Cell(0, d * 60, (d + 1) * 60);
+      snprintf(dayStr, sizeof(dayStr), "%s %d.%d.",
+               *WeekDayName(locTime.tm_wday), locTime.tm_mday, locTime.tm_mon + 1);
+      days[d].Text(dayStr);
+      days[d].Font(GRID_TIME_FONT);
+      days[d].FgColor(GRID_TIME_COLOR);
+      days[d].BgColor(clrTransparent);
+      days[d].Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
+      days[d].X(g.x);
+      days[d].Y(g.y);
+      days[d].W(g.w);
+      days[d].H(g.h);
+      days[d].Generate();
+   }
+
+   events.resize(rows * WEEK_DAYS);
+   boxes.resize(rows * WEEK_DAYS);
+
+   const cYaepgEpgSnapshot *epg = cYaepgEpgIndex::Instance()->Acquire();
+   for (int i = 0; i < rows; i++) {
+      FillRow(i, epg);
+   }
+   epg->Unref();
+
+   for (int i = 0; i < rows; i++) {
+      for (int d = 0; d < WEEK_DAYS; d++) {
+         cYaepgTextBox &box = boxes[i * WEEK_DAYS + d];
+         tGeom g = layout->Cell(i, d * 60, (d + 1) * 60);
+
+         box.Text(events[i * WEEK_DAYS + d].title.c_str());
+         box.Font(GRID_EVENT_FONT);
+         box.FgColor(GRID_EVENT_COLOR);
+         box.BgColor(clrTransparent);
+         box.Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
+         box.X(g.x);
+         box.Y(g.y);
+         box.W(g.w);
+         box.H(g.h);
+         box.Generate();
+      }
+   }
+
+   Row(curY);
+}
+
+void
+cYaepgWeekView::Row(int row)
+{
+   curY = MIN(MAX(row, 0), (int)chanVec.size() - 1);
+}
+
+bool
+cYaepgWeekView::MoveCursor(eCursorDir dir)
+{
+   switch (dir) {
+   case DIR_UP:
+      if (curY == 0) {
+         return false;
+      }
+      curY--;
+      break;
+   case DIR_DOWN:
+      if (curY == (int)chanVec.size() - 1) {
+         return false;
+      }
+      curY++;
+      break;
+   case DIR_LEFT:
+      if (curX == 0) {
+         return false;
+      }
+      curX--;
+      break;
+   case DIR_RIGHT:
+      if (curX == WEEK_DAYS - 1) {
+         return false;
+      }
+      curX++;
+      break;
+   default:
+      ASSERT(0);
+      break;
+   }
+
+   return true;
+}
+
+void
+cYaepgWeekView::Draw(cBitmap *bmp)
+{
+   YAEPG_INFO("Drawing week view at (%d %d)", geom.x, geom.y);
+
+   for (int d = 0; d < WEEK_DAYS; d++) {
+      days[d].Draw(bmp);
+   }
+
+   for (int n = 0; n < (int)boxes.size(); n++) {
+      cYaepgTextBox &box = boxes[n];
+
+      if (n == curY * WEEK_DAYS + curX) {
+         box.FgColor(GRID_SEL_FG);
+         box.BgColor(GRID_SEL_BG);
+      } else {
+         box.FgColor(GRID_EVENT_COLOR);
+         box.BgColor(clrTransparent);
+      }
+      box.Draw(bmp);
+
+      if (n % WEEK_DAYS != WEEK_DAYS - 1) {
+         tGeom g = { box.X(), box.Y(), box.W(), box.H() };
+         tGeom e = layout->EndEdge(g);
+         bmp->DrawRectangle(e.x, e.y, e.x + e.w - 1, e.y + e.h - 1, GRID_SEP_COLOR);
+      }
+   }
+}
+
+
+
+/*
+ *****************************************************************************
+ * cYaepgNowNextView
+ *****************************************************************************
+ */
+cYaepgNowNextView::cYaepgNowNextView(const cChannel *chan) :
+   top(0),
+   cur(0),
+   nowTime(0)
+{
+   geom = GRID_EVENT_GEOM;
+   layout = cYaepgGridLayout::Get(geom, GRID_NUM_CHANS, GRID_HORIZ_SPACE, 2, GRID_VERTICAL);
+   chanLayout = cYaepgGridLayout::Get(GRID_CHAN_GEOM, GRID_NUM_CHANS, GRID_HORIZ_SPACE, 90, GRID_VERTICAL);
+   headLayout = cYaepgGridLayout::Get(GRID_TIME_GEOM, 1, 0, 2, GRID_VERTICAL);
+
+   for (int i = 0; i < 2; i++) {
+      tGeom g = headLayout->Cell(0, i * 60, (i + 1) * 60);
+      heads[i].Text(i == 0 ? tr("Now") : tr("Next"));
+      heads[i].Font(GRID_TIME_FONT);
+      heads[i].FgColor(GRID_TIME_COLOR);
+      heads[i].BgColor(clrTransparent);
+      heads[i].Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
+      heads[i].X(g.x);
+      heads[i].Y(g.y);
+      heads[i].W(g.w);
+      heads[i].H(g.h);
+      heads[i].Generate();
+   }
+
+   list.Build();
+   cur = MAX(list.Find(chan), 0);
+   top = cur;
+   nowTime = time(NULL);
+   Generate();
+}
+
+void
+cYaepgNowNextView::GenerateRow(tNowNextRow &r, int row)
+{
+   const tNowNextEntry &e = list.Entry(r.entry);
+   tGeom band = chanLayout->Band(row);
+   tGeom now = layout->Cell(row, 0, 60);
+   tGeom next = layout->Cell(row, 60, 120);
+   struct tm locTime;
+   char str[256];
+
+   snprintf(str, sizeof(str), "%d %s", e.number, e.name.c_str());
+   r.chanBox.Text(str);
+   r.chanBox.Font(GRID_CHAN_FONT);
+   r.chanBox.FgColor(GRID_CHAN_COLOR);
+   r.chanBox.BgColor(clrTransparent);
+   r.chanBox.Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
+   r.chanBox.X(band.x);
+   r.chanBox.Y(band.y);
+   r.chanBox.W(band.w);
+   r.chanBox.H(band.h);
+   r.chanBox.Generate();
+
+   for (int i = 0; i < 2; i++) {
+      cYaepgTextBox &box = (i == 0) ? r.nowBox : r.nextBox;
+      const tGeom &g = (i == 0) ? now : next;
+      time_t t = (i == 0) ? e.nowStart : e.nextStart;
+      const std::string &title = (i == 0) ? e.nowTitle : e.nextTitle;
+
+      if (t == 0) {
+         snprintf(str, sizeof(str), "%s", tr("No Info"));
+      } else {
+         localtime_r(&t, &locTime);
+         if (iTimeFormat == TIME_FORMAT_24H) {
+            snprintf(str, sizeof(str), "%02d:%02d %s",
+                     locTime.tm_hour, locTime.tm_min, title.c_str());
+         } else {
+            snprintf(str, sizeof(str), "%d:%02d%s %s",
+                     FMT_12HR(locTime.tm_hour), locTime.tm_min,
+                     FMT_AMPM(locTime.tm_hour), title.c_str());
+         }
+      }
+      box.Text(str);
+      box.Font(GRID_EVENT_FONT);
+      box.FgColor(GRID_EVENT_COLOR);
+      box.BgColor(clrTransparent);
+      box.Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
+      box.X(g.x);
+      box.Y(g.y);
+      box.W(g.w);
+      box.H(g.h);
+      box.Generate();
+   }
+}
+
+/*
+ * Rows that were visible before keep their text layout and are only moved,
+ * so scrolling by one channel formats a single new row.
+ */
+void
+cYaepgNowNextView::Generate(void)
+{
+   int visible = MIN(GRID_NUM_CHANS, list.Count());
+
+   prevRows.swap(rows);
+   rows.resize(visible);
+
+   for (int i = 0; i < visible; i++) {
+      int entry = (top + i) % list.Count();
+      int prev;
+
+      for (prev = 0; prev < (int)prevRows.size(); prev++) {
+         if (prevRows[prev].entry == entry) {
+            break;
+         }
+      }
+      rows[i].entry = entry;
+      if (prev < (int)prevRows.size()) {
+         tGeom band = chanLayout->Band(i);
+         int dx = band.x - prevRows[prev].chanBox.X();
+         int dy = band.y - prevRows[prev].chanBox.Y();
+         rows[i].chanBox.Swap(prevRows[prev].chanBox);
+         rows[i].chanBox.Offset(dx, dy);
+         rows[i].nowBox.Swap(prevRows[prev].nowBox);
+         rows[i].nowBox.Offset(dx, dy);
+         rows[i].nextBox.Swap(prevRows[prev].nextBox);
+         rows[i].nextBox.Offset(dx, dy);
+         prevRows[prev].entry = -1;
+         continue;
+      }
+      GenerateRow(rows[i], i);
+   }
+}
+
+/*
+ * Rebuilds the list for the current time, the cursor stays on its channel
+ * even if the channel list changed meanwhile.
+ */
+void
+cYaepgNowNextView::Update(void)
+{
+   const cChannel *chan = list.Count() ? list.Entry(cur).chan : NULL;
+   const cChannel *topChan = list.Count() ? list.Entry(top).chan : NULL;
+
+   list.Build();
+   cur = MAX(list.Find(chan), 0);
+   top = MAX(list.Find(topChan), 0);
+   nowTime = time(NULL);
+   rows.clear();
+   Generate();
+   MoveCursor(0);
+}
+
+void
+cYaepgNowNextView::MoveCursor(int change)
+{
+   int n = list.Count();
+   int visible = MIN(GRID_NUM_CHANS, n);
+
+   if (n == 0) {
+      return;
+   }
+
+   /* The list wraps around like the grid does */
+   cur = ((cur + change) % n + n) % n;
+   if ((cur - top + n) % n >= visible) {
+      top = (change < 0) ? cur : (cur - visible + 1 + n) % n;
+      Generate();
+   }
+}
 
-   return;
+const cChannel *
+cYaepgNowNextView::Channel(void)
+{
+   return list.Count() ? list.Entry(cur).chan : NULL;
 }
 
-void
-cYaepgTextBox::Draw(cBitmap *bmp)
+/*
+ * The present event of the selected channel as it was when the list was
+ * built, without one the time up to the next event.
+ */
+tSelEvent
+cYaepgNowNextView::Event(void)
 {
-   YAEPG_INFO("Drawing text box (%d)", fmtText.size());
+   tEventSnap snap;
+   const tNowNextEntry *e = list.Count() ? &list.Entry(cur) : NULL;
 
-   for (int i = 0; i < (int)fmtText.size(); i++) {
-      /* Fill in background color */
-      if (bgColor != clrTransparent) {
-         bmp->DrawRectangle(geom.x, geom.y,
-                            geom.x + (geom.w - 1), geom.y + (geom.h - 1),
-                            bgColor);
-      }
+   snap.id = e ? e->nowId : 0;
+   snap.start = (e && e->nowId) ? e->nowStart : nowTime;
+   snap.duration = (e && e->nowId) ? e->nowStop - e->nowStart : 0;
+   if (e && !e->nowId && e->nextStart > nowTime) {
+      snap.duration = e->nextStart - nowTime;
+   }
+   snap.vps = 0;
+   snap.flags = 0;
+   if (e) {
+      snap.title = e->nowTitle;
+   }
+   return SelectEvent(e ? e->id : tChannelID::InvalidID, snap);
+}
 
-      /* Draw the text */
-      YAEPG_INFO("Drawing text '%s' at (%d %d color #%08X",
-                 fmtText[i].text.c_str(), fmtText[i].geom.x,
-                 fmtText[i].geom.y, fgColor);
-      YAEPG_INFO("Text widht %d box widht %d",
-                 font->Width(fmtText[i].text.c_str()), geom.w);
+void
+cYaepgNowNextView::Draw(cBitmap *bmp)
+{
+   YAEPG_INFO("Drawing now/next view at (%d %d)", geom.x, geom.y);
+
+   for (int i = 0; i < 2; i++) {
+      heads[i].Draw(bmp);
+   }
+
+   for (int i = 0; i < (int)rows.size(); i++) {
+      tNowNextRow &r = rows[i];
+      const tNowNextEntry &e = list.Entry(r.entry);
+      bool sel = (r.entry == cur);
+
+      r.chanBox.Draw(bmp);
+      r.nowBox.FgColor(sel ? GRID_SEL_FG : GRID_EVENT_COLOR);
+      r.nowBox.BgColor(sel ? GRID_SEL_BG : clrTransparent);
+      r.nowBox.Draw(bmp);
+      r.nextBox.FgColor(sel ? GRID_SEL_FG : GRID_EVENT_COLOR);
+      r.nextBox.BgColor(sel ? GRID_SEL_BG : clrTransparent);
+      r.nextBox.Draw(bmp);
+
+      tGeom g = { r.nowBox.X(), r.nowBox.Y(), r.nowBox.W(), r.nowBox.H() };
+
+      /* Progress of the present event along the edge of its box */
+      if (e.nowStop > e.nowStart && nowTime > e.nowStart) {
+         int lo = layout->Lo(g);
+         int len = layout->Hi(g) - lo;
+         int hi = lo + (int)((int64_t)len * MIN(nowTime - e.nowStart, e.nowStop - e.nowStart) /
+                             (e.nowStop - e.nowStart));
+         if (hi > lo) {
+            tGeom p = layout->Strip(g, lo, hi, GRID_PROGRESS_HEIGHT);
+            bmp->DrawRectangle(p.x, p.y, p.x + p.w - 1, p.y + p.h - 1, GRID_PROGRESS_COLOR);
+         }
+      }
 
-      bmp->DrawText(fmtText[i].geom.x, fmtText[i].geom.y,
-                    fmtText[i].text.c_str(), fgColor, bgColor, font);
+      tGeom s = layout->EndEdge(g);
+      bmp->DrawRectangle(s.x, s.y, s.x + s.w - 1, s.y + s.h - 1, GRID_SEP_COLOR);
    }
 }
 
@@ -689,318 +1928,237 @@ cYaepgTextBox::Draw(cBitmap *bmp)
 
 /*
  *****************************************************************************
- * cYaepgGrid
+ * cYaepgSearchView
  *****************************************************************************
  */
-cYaepgGrid::cNoInfoEvent::cNoInfoEvent(time_t startTime) :
-   cEvent(0)
-{
-   SetStartTime(startTime);
-   SetDuration(9000);
-   SetTitle(tr("No Info"));
-   SetDescription(tr("No Info"));
-}
+static const char *tapChars[] = {
+   " 0",
+   "1",
+   "abc2",
+   "def3",
+   "ghi4",
+   "jkl5",
+   "mno6",
+   "pqrs7",
+   "tuv8",
+   "wxyz9"
+};
 
-cYaepgGrid::cYaepgGrid(std::vector< cChannel *> &chans, int time) :
-   startTime(time),
-   chanVec(chans),
-   curX(0),
-   curY(0)
+cYaepgSearchView::cYaepgSearchView(void) :
+   lastKey(kNone),
+   tap(0),
+   searchPending(false),
+   top(0),
+   cur(0)
 {
-   noInfoEvents.clear();
    geom = GRID_EVENT_GEOM;
-   horizSpace = GRID_HORIZ_SPACE;
-   gridRowHeight = (float)(geom.h - ((chanVec.size() - 1) * horizSpace)) /
-                   (float)chanVec.size();
-   gridPixPerMin = (float)geom.w / (float)90;
-   leftArrows.resize(chanVec.size());
-   rightArrows.resize(chanVec.size());
-   Generate();
+   layout = cYaepgGridLayout::Get(geom, GRID_NUM_CHANS, GRID_HORIZ_SPACE, 90);
+   boxes.resize(GRID_NUM_CHANS);
+   GenerateQuery();
 }
 
-cYaepgGrid::~cYaepgGrid()
+/*
+ * Pressing the same number key again within a second replaces the last
+ * character with the next one of that key, Left deletes it.  Returns true
+ * if the query has changed, the search itself waits for Poll().
+ */
+bool
+cYaepgSearchView::ProcessInput(eKeys key)
 {
-   std::vector< const cEvent *>::iterator it;
+   int k = key & ~k_Repeat;
 
-   for (it = noInfoEvents.begin();
-        it != noInfoEvents.end();
-        it ++) {
-      delete *it;
+   if (k >= k0 && k <= k9) {
+      if (key & k_Repeat) {
+         return false;
+      }
+      const char *chars = tapChars[k - k0];
+      if (k == lastKey && !tapTimeout.TimedOut() && !query.empty()) {
+         tap = (tap + 1) % strlen(chars);
+         query[query.size() - 1] = chars[tap];
+      } else {
+         tap = 0;
+         query += chars[0];
+      }
+      lastKey = k;
+      tapTimeout.Set(SEARCH_TAP_MS);
+   } else if (k == kLeft && !query.empty()) {
+      query.erase(query.size() - 1);
+      lastKey = kNone;
+   } else {
+      return false;
    }
-   noInfoEvents.clear();
+
+   searchPending = true;
+   searchDelay.Set(SEARCH_DELAY_MS);
+   GenerateQuery();
+   return true;
 }
 
-void
-cYaepgGrid::FixCursor(void)
+/*
+ * Runs the search once typing has paused, returns true if it did.
+ */
+bool
+cYaepgSearchView::Poll(void)
 {
-   if (curY < 0) {
-      curY = 0;
-   }
-   if (curY >= (int)events.size()) {
-      curY = events.size() - 1;
-   }
-
-   if (curX < 0) {
-      curX = 0;
-   }
-   if (curX >= (int)events[curY].size()) {
-      curX = events[curY].size() - 1;
+   if (!searchPending || !searchDelay.TimedOut()) {
+      return false;
    }
+   searchPending = false;
+   Search();
+   return true;
 }
 
 void
-cYaepgGrid::Row(int row)
+cYaepgSearchView::Search(void)
 {
-   curY = row;
-   FixCursor();
+   const cYaepgEpgSnapshot *epg = cYaepgEpgIndex::Instance()->Acquire();
+   epg->Search(query.c_str(), time(NULL), SEARCH_MAX_HITS, hits);
+   epg->Unref();
+
+   YAEPG_INFO("Search '%s', %d hits", query.c_str(), (int)hits.size());
+
+   top = 0;
+   cur = 0;
+   GenerateQuery();
+   GenerateRows();
 }
 
 void
-cYaepgGrid::Col(int col)
+cYaepgSearchView::GenerateQuery(void)
 {
-   curX = col;
-   FixCursor();
+   tGeom g = GRID_TIME_GEOM;
+   char str[256];
+
+   snprintf(str, sizeof(str), "%s: %s_  (%d)", tr("Search"), query.c_str(), (int)hits.size());
+   queryBox.Text(str);
+   queryBox.Font(GRID_TIME_FONT);
+   queryBox.FgColor(GRID_TIME_COLOR);
+   queryBox.BgColor(clrTransparent);
+   queryBox.Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
+   queryBox.X(g.x);
+   queryBox.Y(g.y);
+   queryBox.W(g.w);
+   queryBox.H(g.h);
+   queryBox.Generate();
 }
 
 void
-cYaepgGrid::Generate(void)
+cYaepgSearchView::GenerateRows(void)
 {
-   YAEPG_INFO("Generating grid");
-
-   const cSchedule *curSched;
-   const cEvent *curEvent;
-   time_t curTime, endTime;
-   time_t evStart, evDuration;
-   eTextFlags evFlags;
-   time_t gridStart;
+   struct tm locTime;
+   char str[256];
 
-   gridStart = startTime - (startTime % 1800);
-   events.clear();
-   events.resize(chanVec.size());
-   cSchedulesLock SchedulesLock;
-   const cSchedules* Schedules = cSchedules::Schedules(SchedulesLock);
-   for (int i = 0; i < (int)chanVec.size(); i++) {
-      curSched = Schedules->GetSchedule(chanVec[i]->GetChannelID());
-      curTime = gridStart;
-      endTime = curTime + 5400;
-      int j = 0;
-
-      while (curTime < endTime) {
-         events[i].resize(events[i].size() + 1);
-         if (curSched != NULL) {
-            curEvent = curSched->GetEventAround(curTime);
-            if ((curEvent != NULL) &&
-                (curEvent->StartTime() + curEvent->Duration()) <= curTime) {
-               curEvent = NULL;
-            }
-         } else {
-            curEvent = NULL;
-         }
+   for (int i = 0; i < (int)boxes.size(); i++) {
+      tGeom g = layout->Band(i);
+      cYaepgTextBox &box = boxes[i];
 
-         if (curEvent == NULL) {
-            curEvent = new cNoInfoEvent(curTime);
-            noInfoEvents.push_back(curEvent);
-         }
+      if (top + i < (int)hits.size()) {
+         const tSearchHit &hit = hits[top + i];
+         time_t t = hit.event.start;
 
-         evFlags = (eTextFlags)0;
-         evStart = curEvent->StartTime();
-         evDuration = curEvent->Duration();
-         if (evStart < gridStart) {
-            evFlags = (eTextFlags)(evFlags | TBOX_ARROW_LEFT);
-            evStart = gridStart;
-            evDuration -= gridStart - curEvent->StartTime();
-         }
-         if ((evStart + evDuration) > endTime) {
-            evFlags = (eTextFlags)(evFlags | TBOX_ARROW_RIGHT);
-            evDuration = endTime - evStart;
+         localtime_r(&t, &locTime);
+         if (iTimeFormat == TIME_FORMAT_24H) {
+            snprintf(str, sizeof(str), "%s %02d:%02d  %s  %s",
+                     *WeekDayName(locTime.tm_wday), locTime.tm_hour, locTime.tm_min,
+                     hit.chanName.c_str(), hit.event.title.c_str());
+         } else {
+            snprintf(str, sizeof(str), "%s %d:%02d%s  %s  %s",
+                     *WeekDayName(locTime.tm_wday), FMT_12HR(locTime.tm_hour),
+                     locTime.tm_min, FMT_AMPM(locTime.tm_hour),
+                     hit.chanName.c_str(), hit.event.title.c_str());
          }
-
-         ASSERT(evDuration <= 5400);
-         ASSERT(evStart >= curTime);
-         ASSERT(evStart + evDuration <= endTime);
-
-         events[i][j].event = curEvent;
-         events[i][j].box.Text(curEvent->Title());
-         events[i][j].box.Font(GRID_EVENT_FONT);
-         events[i][j].box.FgColor(GRID_EVENT_COLOR);
-         events[i][j].box.BgColor(clrTransparent);
-         events[i][j].box.Flags((eTextFlags)(evFlags | TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
-         events[i][j].box.X(geom.x + ROUND((float)((evStart - gridStart) / 60) * gridPixPerMin));
-         events[i][j].box.Y(geom.y + ROUND(((float)i * (gridRowHeight + (float)horizSpace))));
-         events[i][j].box.W(ROUND((float)(evDuration / 60) * gridPixPerMin));
-         events[i][j].box.H(ROUND(gridRowHeight));
-         events[i][j].box.Generate();
-
-         YAEPG_INFO("Event [%d][%d] (%d %d, %d %d) '%s'", i, j,
-                    events[i][j].box.X(), events[i][j].box.Y(),
-                    events[i][j].box.W(), events[i][j].box.H(),
-                    curEvent->Title());
-
-         curTime = curEvent->StartTime() + curEvent->Duration();
-         j++;
+         box.Text(str);
+      } else {
+         box.Text("");
       }
-
-      /*
-       * Generate the arrows
-       * XXX Most of the arrow initialization could be done once when the grid is constructed
-       */
-      leftArrows[i].Text("<");
-      leftArrows[i].Font(GRID_EVENT_FONT);
-      leftArrows[i].FgColor(GRID_EVENT_COLOR);
-      leftArrows[i].BgColor(clrTransparent);
-      leftArrows[i].Flags((eTextFlags)(TBOX_VALIGN_RIGHT | TBOX_HALIGN_CENTER));
-      leftArrows[i].X(geom.x - LEFT_ARROW_WIDTH);
-      leftArrows[i].Y(geom.y + ROUND(((float)i * (gridRowHeight + (float)horizSpace))));
-      leftArrows[i].W(LEFT_ARROW_WIDTH);
-      leftArrows[i].H(ROUND(gridRowHeight));
-      leftArrows[i].Generate();
-
-      rightArrows[i].Text(">");
-      rightArrows[i].Font(GRID_EVENT_FONT);
-      rightArrows[i].FgColor(GRID_EVENT_COLOR);
-      rightArrows[i].BgColor(clrTransparent);
-      rightArrows[i].Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
-      rightArrows[i].X(geom.x + geom.w);
-      rightArrows[i].Y(geom.y + ROUND(((float)i * (gridRowHeight + (float)horizSpace))));
-      rightArrows[i].W(RIGHT_ARROW_WIDTH);
-      rightArrows[i].H(ROUND(gridRowHeight));
-      rightArrows[i].Generate();
+      box.Font(GRID_EVENT_FONT);
+      box.FgColor(GRID_EVENT_COLOR);
+      box.BgColor(clrTransparent);
+      box.Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
+      box.X(g.x);
+      box.Y(g.y);
+      box.W(g.w);
+      box.H(g.h);
+      box.Generate();
    }
-
-   FixCursor();
 }
 
-bool
-cYaepgGrid::MoveCursor(eCursorDir dir)
+void
+cYaepgSearchView::MoveCursor(int change)
 {
-   switch (dir) {
-   case DIR_UP:
-      if (curY == 0) {
-         return false;
-      }
-      curY--;
-      break;
-   case DIR_DOWN:
-      if (curY == (int)(events.size() - 1)) {
-         return false;
-      }
-      curY++;
-      break;
-   case DIR_LEFT:
-      if (curX == 0) {
-         return false;
-      }
-      curX--;
-      break;
-   case DIR_RIGHT:
-      if (curX == (int)(events[curY].size() - 1)) {
-         return false;
-      }
-      curX++;
-      break;
-   default:
-      ASSERT(0);
-      break;
+   int n = hits.size();
+
+   if (n == 0) {
+      return;
    }
 
-   if (curX >= (int)events[curY].size()) {
-      curX = events[curY].size() - 1;
+   cur = MIN(MAX(cur + change, 0), n - 1);
+   if (cur < top || cur >= top + (int)boxes.size()) {
+      top = (cur < top) ? cur : cur - (int)boxes.size() + 1;
+      GenerateRows();
    }
+}
 
-   ASSERT(curY >= 0 && curY < (int)events.size());
-   ASSERT(curX >= 0 && curX < (int)events[curY].size());
+tSelEvent
+cYaepgSearchView::Event(void)
+{
+   const tSearchHit *hit = Hit();
 
-   return true;
+   if (hit == NULL) {
+      tSelEvent none;
+      none.event.start = time(NULL);
+      return SelectEvent(NULL, none.event);
+   }
+   return SelectEvent(hit->chan, hit->event);
 }
 
 void
-cYaepgGrid::Draw(cBitmap *bmp)
+cYaepgSearchView::Draw(cBitmap *bmp)
 {
-   YAEPG_INFO("Drawing grid at (%d %d)", geom.x, geom.y);
-
-   for (int i = 0; i < (int)events.size(); i++) {
-      for (int j = 0; j < (int)events[i].size(); j++) {
-         /* Is this the currently selected event */
-         if (i == curY && j == curX) {
-            events[i][j].box.FgColor(GRID_SEL_FG);
-            events[i][j].box.BgColor(GRID_SEL_BG);
-
-            /* Check to see if the arrow is "selected" */
-            if (j == 0) {
-               leftArrows[i].FgColor(GRID_SEL_FG);
-               leftArrows[i].BgColor(GRID_SEL_BG);
-            } else {
-               leftArrows[i].FgColor(GRID_EVENT_COLOR);
-               leftArrows[i].BgColor(clrTransparent);
-            }
-            if (j == (int)(events[i].size() - 1)) {
-               rightArrows[i].FgColor(GRID_SEL_FG);
-               rightArrows[i].BgColor(GRID_SEL_BG);
-            } else {
-               rightArrows[i].FgColor(GRID_EVENT_COLOR);
-               rightArrows[i].BgColor(clrTransparent);
-            }
-         } else {
-            events[i][j].box.FgColor(GRID_EVENT_COLOR);
-            events[i][j].box.BgColor(clrTransparent);
-            leftArrows[i].FgColor(GRID_EVENT_COLOR);
-            leftArrows[i].BgColor(clrTransparent);
-            rightArrows[i].FgColor(GRID_EVENT_COLOR);
-            rightArrows[i].BgColor(clrTransparent);
-         }
-         events[i][j].box.Draw(bmp);
-
-         /* Draw the arrow boxes */
-         if (events[i][j].box.Flags() & TBOX_ARROW_LEFT) {
-            leftArrows[i].Text("<");
-         } else {
-            leftArrows[i].Text("");
-         }
-         leftArrows[i].Generate();
-         leftArrows[i].Draw(bmp);
+   YAEPG_INFO("Drawing search view at (%d %d)", geom.x, geom.y);
 
-         if (events[i][j].box.Flags() & TBOX_ARROW_RIGHT) {
-            rightArrows[i].Text(">");
-         } else {
-            rightArrows[i].Text("");
-            rightArrows[i].BgColor(clrTransparent);
-         }
-         rightArrows[i].Generate();
-         rightArrows[i].Draw(bmp);
-
-         /* Draw a separator if there is no right arrow */
-         if ((events[i][j].box.Flags() & TBOX_ARROW_RIGHT) == 0) {
-            YAEPG_INFO("Drawing separator at (%d %d, %d %d)",
-                       events[i][j].box.X() + events[i][j].box.W() - 1,
-                       events[i][j].box.Y(),
-                       events[i][j].box.X() + events[i][j].box.W(),
-                       events[i][j].box.Y() + ROUND(gridRowHeight));
-
-            bmp->DrawRectangle(events[i][j].box.X() + events[i][j].box.W() - 1,
-                               events[i][j].box.Y(),
-                               events[i][j].box.X() + events[i][j].box.W(),
-                               events[i][j].box.Y() + ROUND(gridRowHeight),
-                               GRID_SEP_COLOR);
-         }
-      } /* for j < events[i].size() */
-   } /* for i < events.size() */
+   queryBox.Draw(bmp);
+   for (int i = 0; i < (int)boxes.size() && top + i < (int)hits.size(); i++) {
+      bool sel = (top + i == cur);
+      boxes[i].FgColor(sel ? GRID_SEL_FG : GRID_EVENT_COLOR);
+      boxes[i].BgColor(sel ? GRID_SEL_BG : clrTransparent);
+      boxes[i].Draw(bmp);
+   }
 }
 
 
+
 /*
  *****************************************************************************
  * cYaepgGridChans
  *****************************************************************************
  */
 
-cYaepgGridChans::cYaepgGridChans(std::vector< cChannel * > &chans) :
-   chanVec(chans)
+cYaepgGridChans::cYaepgGridChans(std::vector< const cChannel * > &chans) :
+   chanVec(chans),
+   logos(NULL),
+   logoSize(0)
 {
    geom = GRID_CHAN_GEOM;
-   horizSpace = GRID_HORIZ_SPACE;
-   chanRowHeight = (float)(geom.h - ((chanVec.size() - 1) * horizSpace)) /
-                   (float)chanVec.size();
-   chanInfo.resize(GRID_NUM_CHANS);
+   layout = cYaepgGridLayout::Get(geom, chanVec.size(), GRID_HORIZ_SPACE, 90, GRID_VERTICAL);
+
+   /*
+    * The logo column is as wide as a 16:9 box of the thinnest row, so all
+    * logos have the same size and share one atlas.
+    */
+   if (iChannelLogos && layout->Rows() > 0) {
+      int thick = layout->RowSize(0);
+      for (int i = 1; i < layout->Rows(); i++) {
+         thick = MIN(thick, layout->RowSize(i));
+      }
+      if (layout->Vertical()) {
+         logoSize = thick * 9 / 16;
+         logos = cYaepgLogoAtlas::Get(thick, logoSize);
+      } else {
+         logoSize = thick * 16 / 9;
+         logos = cYaepgLogoAtlas::Get(logoSize, thick);
+      }
+   }
    Generate();
 }
 
@@ -1009,37 +2167,61 @@ cYaepgGridChans::Generate(void)
 {
    char numStr[16];
 
-   for (int i = 0; i < GRID_NUM_CHANS; i++) {
+   /* Channel rows are cached by channel, scrolling only moves them */
+   prevChanInfo.swap(chanInfo);
+   chanInfo.resize(chanVec.size());
+
+   for (int i = 0; i < (int)chanVec.size(); i++) {
+      tGeom band = layout->Band(i);
+      tGeom logo = layout->Slice(band, layout->Lo(band), layout->Lo(band) + logoSize);
+      int lo = layout->Lo(band) + logoSize;
+      int mid = (lo + layout->Hi(band)) / 2;
+      tGeom num = layout->Slice(band, lo, mid);
+      tGeom name = layout->Slice(band, iChannelNumber ? mid : lo, layout->Hi(band));
+      int prev;
+
+      for (prev = 0; prev < (int)prevChanInfo.size(); prev++) {
+         if (prevChanInfo[prev].c == chanVec[i]) {
+            break;
+         }
+      }
+      if (prev < (int)prevChanInfo.size()) {
+         int dx = num.x - prevChanInfo[prev].numBox.X();
+         int dy = num.y - prevChanInfo[prev].numBox.Y();
+         chanInfo[i].c = chanVec[i];
+         chanInfo[i].logo = prevChanInfo[prev].logo;
+         chanInfo[i].logoGeom = logo;
+         chanInfo[i].numBox.Swap(prevChanInfo[prev].numBox);
+         chanInfo[i].numBox.Offset(dx, dy);
+         chanInfo[i].nameBox.Swap(prevChanInfo[prev].nameBox);
+         chanInfo[i].nameBox.Offset(dx, dy);
+         prevChanInfo[prev].c = NULL;
+         continue;
+      }
+
+      chanInfo[i].c = chanVec[i];
+      chanInfo[i].logo = logos ? logos->Slot(chanVec[i]) : -1;
+      chanInfo[i].logoGeom = logo;
       snprintf(numStr, sizeof(numStr), "%d", chanVec[i]->Number());
       chanInfo[i].numBox.Text(numStr);
       chanInfo[i].numBox.Font(GRID_CHAN_FONT);
       chanInfo[i].numBox.FgColor(GRID_CHAN_COLOR);
       chanInfo[i].numBox.BgColor(clrTransparent);
       chanInfo[i].numBox.Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
-      chanInfo[i].numBox.X(geom.x);
-      chanInfo[i].numBox.Y(geom.y + ROUND((float)i * (chanRowHeight + (float)horizSpace)));
-      chanInfo[i].numBox.W(geom.w / 2);
-      chanInfo[i].numBox.H(ROUND(chanRowHeight));
+      chanInfo[i].numBox.X(num.x);
+      chanInfo[i].numBox.Y(num.y);
+      chanInfo[i].numBox.W(num.w);
+      chanInfo[i].numBox.H(num.h);
       chanInfo[i].numBox.Generate();
       chanInfo[i].nameBox.Text(chanVec[i]->Name());
       chanInfo[i].nameBox.Font(GRID_CHAN_FONT);
       chanInfo[i].nameBox.FgColor(GRID_CHAN_COLOR);
       chanInfo[i].nameBox.BgColor(clrTransparent);
       chanInfo[i].nameBox.Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
-
-      if (iChannelNumber)
-      {
-          chanInfo[i].nameBox.X(geom.x + (geom.w / 2));
-          chanInfo[i].nameBox.W(geom.w / 2);
-      }
-      else
-      {
-          chanInfo[i].nameBox.X(geom.x);
-          chanInfo[i].nameBox.W(geom.w );
-      }
-
-      chanInfo[i].nameBox.Y(geom.y + ROUND((float)i * (chanRowHeight + (float)horizSpace)));
-      chanInfo[i].nameBox.H(ROUND(chanRowHeight));
+      chanInfo[i].nameBox.X(name.x);
+      chanInfo[i].nameBox.Y(name.y);
+      chanInfo[i].nameBox.W(name.w);
+      chanInfo[i].nameBox.H(name.h);
       chanInfo[i].nameBox.Generate();
 
       YAEPG_INFO("Chan [%d] (%d %d, %d %d) '%s %s'", i,
@@ -1056,6 +2238,10 @@ cYaepgGridChans::Draw(cBitmap *bmp)
    YAEPG_INFO("Drawing grid channels at (%d %d)", geom.x, geom.y);
 
    for (int i = 0; i < (int)chanInfo.size(); i++) {
+       if (chanInfo[i].logo >= 0) {
+          const tGeom &g = chanInfo[i].logoGeom;
+          logos->Draw(bmp, chanInfo[i].logo, g.x + (g.w - logos->Width()) / 2, g.y + (g.h - logos->Height()) / 2);
+       }
        if (iChannelNumber)
           chanInfo[i].numBox.Draw(bmp);
        chanInfo[i].nameBox.Draw(bmp);
@@ -1074,6 +2260,7 @@ cYaepgGridTime::cYaepgGridTime(time_t _startTime) :
    startTime(_startTime)
 {
    geom = GRID_TIME_GEOM;
+   layout = cYaepgGridLayout::Get(geom, 1, 0, 90, GRID_VERTICAL);
    times.resize(3);
    Generate();
 }
@@ -1084,10 +2271,10 @@ cYaepgGridTime::Generate(void)
    time_t curTime = startTime;
    struct tm locTime;
    char timeStr[32];
-   int timeWidth;
 
-   timeWidth = geom.w / 3;
    for (int i = 0; i < 3; i++) {
+      tGeom g = layout->Cell(0, i * 1800, (i + 1) * 1800);
+
       localtime_r(&curTime, &locTime);
       locTime.tm_min = (locTime.tm_min >= 30) ? 30 : 0;
       if (iTimeFormat == TIME_FORMAT_24H) {
@@ -1103,10 +2290,10 @@ cYaepgGridTime::Generate(void)
       times[i].FgColor(GRID_TIME_COLOR);
       times[i].BgColor(clrTransparent);
       times[i].Flags((eTextFlags)(TBOX_VALIGN_LEFT | TBOX_HALIGN_CENTER));
-      times[i].X(geom.x + (i * timeWidth));
-      times[i].Y(geom.y);
-      times[i].W(timeWidth);
-      times[i].H(geom.h);
+      times[i].X(g.x);
+      times[i].Y(g.y);
+      times[i].W(g.w);
+      times[i].H(g.h);
       times[i].Generate();
       curTime += 1800;
    }
@@ -1186,7 +2373,7 @@ cYaepgGridDate::Draw(cBitmap *bmp)
  * cYaepgEventTitle
  *****************************************************************************
  */
-cYaepgEventTitle::cYaepgEventTitle(const cEvent *_event) :
+cYaepgEventTitle::cYaepgEventTitle(const tSelEvent &_event) :
    event(_event)
 {
    geom = EVENT_TITLE_GEOM;
@@ -1196,7 +2383,7 @@ cYaepgEventTitle::cYaepgEventTitle(const cEvent *_event) :
 void
 cYaepgEventTitle::Generate(void)
 {
-   box.Text(event->Title());
+   box.Text(event.event.title.c_str());
    box.Font(EVENT_TITLE_FONT);
    box.FgColor(EVENT_TITLE_COLOR);
    box.BgColor(clrTransparent);
@@ -1221,8 +2408,9 @@ cYaepgEventTitle::Draw(cBitmap *bmp)
  * cYaepgEventInfo
  *****************************************************************************
  */
-cYaepgEventInfo::cYaepgEventInfo(const cEvent *_event) :
-   event(_event)
+cYaepgEventInfo::cYaepgEventInfo(const tSelEvent &_event) :
+   event(_event),
+   generated(false)
 {
    geom = EVENT_INFO_GEOM;
    Generate();
@@ -1237,53 +2425,81 @@ cYaepgEventInfo::Generate(void)
    const char* r=NULL;
 
    eTimerMatch timerMatch=tmNone;
-   cTimer* ti;
+   bool recording=false;
+   bool switchTimer=false;
+   bool vps=false;
+   bool running=false;
 
-   if (iRemoteTimer && pRemoteTimers && event) {
-      RemoteTimers_GetMatch_v1_0 rtMatch;
-      rtMatch.event = event;
-      pRemoteTimers->Service("RemoteTimers::GetMatch-v1.0", &rtMatch);
-      timerMatch = (eTimerMatch)rtMatch.timerMatch;
-      ti = rtMatch.timer;
+   /* The symbols only change with the event, the timers or the EPG data */
+   if (!stateKeys.Changed() && generated && event.Same(genEvent)) {
+      return;
+   }
+   genEvent = event;
+   generated = true;
+
+   /* The event is only valid while the schedules stay locked */
+   if (iRemoteTimer && pRemoteTimers) {
+      YAEPG_SCHEDULES_READ;
+      const cEvent *e = event.Find(Schedules);
+      if (e != NULL) {
+         RemoteTimers_GetMatch_v1_0 rtMatch;
+         rtMatch.event = e;
+         pRemoteTimers->Service("RemoteTimers::GetMatch-v1.0", &rtMatch);
+         timerMatch = (eTimerMatch)rtMatch.timerMatch;
+         recording = rtMatch.timer && rtMatch.timer->Recording();
+      }
+   }
+   else {
+      YAEPG_TIMERS_READ;
+      YAEPG_SCHEDULES_READ;
+      const cEvent *e = event.Find(Schedules);
+      const cTimer *ti = e ? Timers->GetMatch(e, &timerMatch) : NULL;
+      recording = ti && ti->Recording();
+   }
+
+   {
+      YAEPG_SCHEDULES_READ;
+      const cEvent *e = event.Find(Schedules);
+      if (iSwitchTimer && pEPGSearch && e) {
+         Epgsearch_switchtimer_v1_0* serviceData = new Epgsearch_switchtimer_v1_0;
+         serviceData->event = e;
+         serviceData->mode = 0;
+         if (pEPGSearch->Service("Epgsearch-switchtimer-v1.0", serviceData)){
+            switchTimer = serviceData->success;
+            delete serviceData;
+         }
+      }
+      vps = e && e->Vps() && (e->Vps() - e->StartTime());
+      running = e && e->SeenWithin(30) && e->IsRunning();
    }
-   else
-      ti=Timers.GetMatch(event, &timerMatch);
 
    switch (timerMatch) {
       case tmFull:
          if (iInfoSymbols && iVDRSymbols)
-            t=ti->Recording()?cFontSymbols::Recording():cFontSymbols::Watch();
+            t=recording?cFontSymbols::Recording():cFontSymbols::Watch();
          else
-            t=ti->Recording()?"R":"T";
+            t=recording?"R":"T";
          break;
       case tmPartial:
          if (iInfoSymbols && iVDRSymbols)
-            t=ti->Recording()?cFontSymbols::Recording():cFontSymbols::WatchUpperHalf();
+            t=recording?cFontSymbols::Recording():cFontSymbols::WatchUpperHalf();
          else
-            t=ti->Recording()?"R":"t";
+            t=recording?"R":"t";
          break;
       default:
          t=" ";
          break;
    }
 
-   if (iSwitchTimer && pEPGSearch && event) {
-      Epgsearch_switchtimer_v1_0* serviceData = new Epgsearch_switchtimer_v1_0;
-      serviceData->event = event;
-      serviceData->mode = 0;
-      if (pEPGSearch->Service("Epgsearch-switchtimer-v1.0", serviceData)){
-         if(serviceData->success){
-            t=(iInfoSymbols && iVDRSymbols)?cFontSymbols::ArrowCCW():"S" ;
-         }
-         delete serviceData;
-      }
+   if (switchTimer) {
+      t=(iInfoSymbols && iVDRSymbols)?cFontSymbols::ArrowCCW():"S" ;
    }
-   if (event->Vps() && (event->Vps() - event->StartTime()))
+   if (vps)
       v=(iInfoSymbols && iVDRSymbols)?cFontSymbols::VPS():"V";
    else
       v=" ";
 
-   if (event->SeenWithin(30) && event->IsRunning())
+   if (running)
       r=(iInfoSymbols && iVDRSymbols)?cFontSymbols::Running():"*";
    else
       r=" " ;
@@ -1332,98 +2548,90 @@ cYaepgEventInfo::Draw(cBitmap *bmp)
  * cYaepgEventEpgImage
  *****************************************************************************
  */
-cYaepgEventEpgImage::cYaepgEventEpgImage(const cEvent *_event) :
-   event(_event), EpgImage(NULL)
+cYaepgEventEpgImage::cYaepgEventEpgImage(tEventID _eventId) :
+   eventId(_eventId),
+   job(NULL),
+   image(NULL)
 {
    geom = EVENT_EPGIMAGE_GEOM;
+   cYaepgImageLoader::Instance()->Index(geom.w, geom.h, iResizeImages);
    Generate();
 }
 
-void
-cYaepgEventEpgImage::Generate(void)
+cYaepgEventEpgImage::~cYaepgEventEpgImage()
 {
-   Magick::Image image;
+   Clear();
+}
 
-   char *strFilename = NULL;
+void
+cYaepgEventEpgImage::Clear(void)
+{
+   if (job != NULL) {
+      job->Cancel();
+      job->Unref();
+      job = NULL;
+   }
+   if (image != NULL) {
+      image->Unref();
+      image = NULL;
+   }
+}
 
-   if (-1 == asprintf(&strFilename, "%s/%d.%s",sEpgImagesDir.c_str(),event->EventID(), imageExtensionTexts[iImageExtension]))
-   {
-       YAEPG_ERROR("Couldn't built epg image filename!");
-       delete strFilename;
-       return;
+/*
+ * Hands the image to the loader, unless it's cached the widget stays empty
+ * until Poll() finds it decoded.  A request for the previous event is cancelled, so moving the
+ * cursor quickly doesn't queue up images nobody will see.
+ */
+void
+cYaepgEventEpgImage::Generate(void)
+{
+   Clear();
+   if (eventId == 0) {
+      return;
    }
 
-   try {
-      Geometry geo;
-      image.read(strFilename);
-      geo = image.size();
-      int w = geo.width();
-      int h = geo.height();
-      if (geom.h != h || geom.w != w) {
-         switch (iResizeImages) {
-         case 0:
-            image.sample(Geometry(geom.w, geom.h));
-            break;
-         case 1:
-            image.scale(Geometry(geom.w, geom.h));
-            break;
-         case 2:
-            image.zoom(Geometry(geom.w, geom.h));
-            break;
-         default:
-             YAEPG_ERROR("ERROR: unknown resize mode %d", iResizeImages);
-             break;
-         }
-         geo = image.size();
-         w = geo.width();
-         h = geo.height();
-      }
+   /* Most events have no image, don't even try to open one */
+   const char *ext = imageExtensionTexts[iImageExtension];
+   time_t mtime;
+   if (!cYaepgImageIndex::Instance()->Find(eventId, ext, mtime)) {
+      return;
+   }
 
-      image.opacity(OpaqueOpacity);
-      image.backgroundColor(Color(0, 0, 0, 0));
-      image.quantizeColorSpace(RGBColorspace);
-      image.quantizeColors(255);
-      image.quantize();
+   cString file = cString::sprintf("%s/%u.%s", sEpgImagesDir.c_str(), (unsigned int)eventId, ext);
+   job = cYaepgImageLoader::Instance()->Submit(eventId, mtime, file, geom.w, geom.h, iResizeImages);
 
-      EpgImage = new cBitmap(geom.w, geom.h, image.depth());
+   /* Cached images are ready right away */
+   if (job != NULL && job->Done()) {
+      Poll();
+   }
+}
 
-      // center image
-      int x = 0;
-      int y = 0;
-      x += ((geom.w - w) / 2);
-      y += ((geom.h - h) / 2);
+/*
+ * Returns true once when the requested image has been decoded.
+ */
+bool
+cYaepgEventEpgImage::Poll(void)
+{
+   if (job == NULL || !job->Done()) {
+      return false;
+   }
 
-      const Magick::PixelPacket *pix = image.getConstPixels(0, 0, w, h);
-      for (int iy = 0; iy < h; ++iy) {
-        for (int ix = 0; ix < w; ++ix) {
-          tColor col = (~(int)(pix->opacity * 255 / MaxRGB) << 24)
-                     | ((int)(pix->red * 255 / MaxRGB) << 16)
-                     | ((int)(pix->green * 255 / MaxRGB) << 8)
-                     | (int)(pix->blue * 255 / MaxRGB);
-          EpgImage->DrawPixel(x + ix, y + iy, col);
-          ++pix;
-        }
-      }
-      delete strFilename;
-   } catch (Magick::Exception &e) {
-      YAEPG_ERROR("Couldn't load epg image %s, %s ", fullFilePath, e.what());
-      delete strFilename;
-      delete EpgImage;
-      EpgImage=NULL;
-   } catch (...) {
-      YAEPG_ERROR("Couldn't load %s: Unknown exception caught", fullFilePath);
-      delete strFilename;
-      delete EpgImage;
-      EpgImage=NULL;
+   image = job->Image();
+   if (image != NULL) {
+      image->Ref();
    }
+   job->Unref();
+   job = NULL;
+
+   return image != NULL;
 }
 
 void
 cYaepgEventEpgImage::Draw(cBitmap *bmp)
 {
    YAEPG_INFO("Drawing event epg image at (%d %d)", geom.x, geom.y);
-   if (EpgImage)
-      bmp->DrawBitmap(geom.x, geom.y, *EpgImage);
+   if (image != NULL)
+      bmp->DrawBitmap(geom.x, geom.y, *image->Bitmap());
 }
 
 /*
@@ -1431,7 +2639,7 @@ cYaepgEventEpgImage::Draw(cBitmap *bmp)
  * cYaepgEventTime
  *****************************************************************************
  */
-cYaepgEventTime::cYaepgEventTime(const cEvent *_event) :
+cYaepgEventTime::cYaepgEventTime(const tSelEvent &_event) :
    event(_event)
 {
    geom = EVENT_TIME_GEOM;
@@ -1445,9 +2653,9 @@ cYaepgEventTime::Generate(void)
    time_t t;
    char timeStr[32];
 
-   t = event->StartTime();
+   t = event.event.start;
    localtime_r(&t, &locStart);
-   t += event->Duration();
+   t += event.event.duration;
    localtime_r(&t, &locEnd);
    if (iTimeFormat == TIME_FORMAT_24H) {
       snprintf(timeStr, sizeof(timeStr), "%02d:%02d - %02d:%02d",
@@ -1486,7 +2694,7 @@ cYaepgEventTime::Draw(cBitmap *bmp)
  * cYaepgEventDesc
  *****************************************************************************
  */
-cYaepgEventDesc::cYaepgEventDesc(const cEvent *_event) :
+cYaepgEventDesc::cYaepgEventDesc(const tSelEvent &_event) :
    event(_event)
 {
    geom = EVENT_DESC_GEOM;
@@ -1496,7 +2704,7 @@ cYaepgEventDesc::cYaepgEventDesc(const cEvent *_event) :
 void
 cYaepgEventDesc::Generate(void)
 {
-   box.Text(event->Description() ? event->Description() : (event->ShortText() ? event->ShortText() : ""));
+   box.Text(!event.description.empty() ? event.description.c_str() : event.event.shortText.c_str());
    box.Font(EVENT_DESC_FONT);
    box.FgColor(EVENT_DESC_COLOR);
    box.BgColor(clrTransparent);
@@ -1575,7 +2783,7 @@ cYaepgTimeLine::cYaepgTimeLine(time_t _startTime) :
    locGeom = TLINE_LOC_GEOM;
    boxGeom = TLINE_BOX_GEOM;
    boxColor = TLINE_BOX_COLOR;
-   pixPerMin = (float)locGeom.w / (float)90;
+   layout = cYaepgGridLayout::Get(locGeom, 1, 0, 90, GRID_VERTICAL);
    UpdateTime(_startTime);
 }
 
@@ -1592,27 +2800,44 @@ cYaepgTimeLine::Generate(void)
    if (startTime > time(NULL)) {
       hidden = true;
    } else {
-      int minOff = (time(NULL) - startTime) / 60;
-      ASSERT(minOff <= 30);
-      xOff = locGeom.x + ROUND((float)minOff * pixPerMin) - (boxGeom.w / 2);
+      int secOff = time(NULL) - startTime;
+      ASSERT(secOff <= 1800);
+      box = layout->Line(secOff, layout->Vertical() ? boxGeom.h : boxGeom.w);
       hidden = false;
-      YAEPG_INFO("Time line minOff %d pixPerMin %d xOff %d",
-                 minOff, ROUND(pixPerMin), xOff);
+      YAEPG_INFO("Time line secOff %d at (%d %d)", secOff, box.x, box.y);
+   }
+}
+
+bool
+cYaepgTimeLine::Geom(tGeom &g)
+{
+   if (hidden) {
+      return false;
    }
+   g = box;
+   return true;
 }
 
 void
 cYaepgTimeLine::Draw(cBitmap *bmp)
 {
    YAEPG_INFO("Drawing time line at (%d %d) (%d %d) %d",
-              xOff, locGeom.y,
-              xOff + boxGeom.w, locGeom.y + (boxGeom.h - 1),
-              hidden);
+              box.x, box.y, box.x + box.w - 1, box.y + box.h - 1, hidden);
+
+   if (!hidden) {
+      bmp->DrawRectangle(box.x, box.y, box.x + box.w - 1, box.y + box.h - 1, boxColor);
+   }
+}
 
+/*
+ * Draw the box straight to the OSD, keeping it out of the composed screen
+ * so that moving it only needs the old rectangle copied back.
+ */
+void
+cYaepgTimeLine::Draw(cOsd *osd)
+{
    if (!hidden) {
-      bmp->DrawRectangle(xOff, locGeom.y,
-                         xOff + boxGeom.w, locGeom.y + (boxGeom.h - 1),
-                         boxColor);
+      osd->DrawRectangle(box.x, box.y, box.x + box.w - 1, box.y + box.h - 1, boxColor);
    }
 }
 
@@ -1760,7 +2985,6 @@ cYaepgInputStra::ProcessKey(eKeys key)
  *****************************************************************************
  */
 cYaepgRecDlg::cYaepgRecDlg(void) :
-   event(NULL),
    curY(0)
 {
    geom = REC_DLG_GEOM;
@@ -1842,15 +3066,23 @@ cYaepgRecDlg::AddTimer(void)
 
     /* Construct the string that represent the event */
     flags = tfActive;
-    channel = Channels.GetByChannelID(event->ChannelID(), true)->Number();
+    {
+      YAEPG_CHANNELS_READ;
+      const cChannel *chan = Channels->GetByChannelID(event.channel, true);
+      if (chan == NULL) {
+        delete recTimer;
+        return false;
+      }
+      channel = chan->Number();
+    }
     snprintf(dayStr, 8, "%d", startInput.recTime.tm_mday);
     start = (startInput.recTime.tm_hour * 100) + startInput.recTime.tm_min;
     stop = (endInput.recTime.tm_hour * 100) + endInput.recTime.tm_min;
     priority = Setup.DefaultPriority;
     lifetime = Setup.DefaultLifetime;
     *file = '\0';
-    if (!isempty(event->Title())) {
-         strncpy(file, event->Title(), sizeof(file));
+    if (!isempty(event.event.title.c_str())) {
+         strn0cpy(file, event.event.title.c_str(), sizeof(file));
     }
     snprintf(eventStr, 256, "%d:%d:%s:%04d:%04d:%d:%d:%s:",
         flags, channel, dayStr, start, stop, priority, lifetime, file);
@@ -1867,8 +3099,10 @@ cYaepgRecDlg::AddTimer(void)
        }
     }
     else {
-      Timers.Add(recTimer);
-      Timers.Save();
+      YAEPG_TIMERS_WRITE;
+      Timers->Add(recTimer);
+      Timers->SetModified();
+      Timers->Save();
     }
     return true;
 }
@@ -1916,12 +3150,12 @@ cYaepgRecDlg::ProcessKey(eKeys key)
 }
 
 void
-cYaepgRecDlg::UpdateEvent(const cEvent *_event)
+cYaepgRecDlg::UpdateEvent(const tSelEvent &_event)
 {
    event = _event;
 
    /* Update the event title */
-   titleBox.Text(event->Title());
+   titleBox.Text(event.event.title.c_str());
    titleBox.Generate();
 
    startBox.Generate();
@@ -1932,9 +3166,9 @@ cYaepgRecDlg::UpdateEvent(const cEvent *_event)
    time_t t;
    char timeStr[32];
 
-   t = event->StartTime();
+   t = event.event.start;
    localtime_r(&t, &locStart);
-   t += event->Duration();
+   t += event.event.duration;
    localtime_r(&t, &locEnd);
    if (iTimeFormat == TIME_FORMAT_24H) {
       snprintf(timeStr, sizeof(timeStr), "%02d:%02d - %02d:%02d",
@@ -1951,8 +3185,8 @@ cYaepgRecDlg::UpdateEvent(const cEvent *_event)
    timeBox.Generate();
 
    /* Fill in initial values for start/end input */
-   startInput.UpdateTime(event->StartTime() - (Setup.MarginStart * 60));
-   endInput.UpdateTime(event->StartTime() + _event->Duration() + (Setup.MarginStop * 60));
+   startInput.UpdateTime(event.event.start - (Setup.MarginStart * 60));
+   endInput.UpdateTime(event.event.EndTime() + (Setup.MarginStop * 60));
 }
 
 void
@@ -15,6 +15,11 @@
 #include <vdr/osdbase.h>
 #include <vdr/timers.h>
 
+#include "EpgIndex.h"
+#include "ImageLoader.h"
+#include "NowNext.h"
+#include "StateKeys.h"
+
 /**
  * Macros to retrieve theme values
  */
@@ -23,6 +28,7 @@
 #define THEME_COLOR(_name) cYaepgTheme::Instance()->Element(_name).u.color
 #define THEME_GEOM(_name)  cYaepgTheme::Instance()->Element(_name).u.geom
 #define THEME_IVAL(_name)  cYaepgTheme::Instance()->Element(_name).u.ival
+#define THEME_INIT(_name)  cYaepgTheme::Instance()->Element(_name).init
 
 #define BG_IMAGE                 THEME_IMAGE("bgImage")
 #define GRID_EVENT_FONT          THEME_FONT("gridEventFont")
@@ -42,6 +48,9 @@
 #define GRID_TIME_COLOR          THEME_COLOR("gridTimeColor")
 #define GRID_DATE_COLOR          THEME_COLOR("gridDateColor")
 #define GRID_SEP_COLOR           THEME_COLOR("gridSepColor")
+#define GRID_BADGE_COLOR         (THEME_INIT("gridBadgeColor") ? THEME_COLOR("gridBadgeColor") : GRID_EVENT_COLOR)
+#define GRID_NOW_COLOR           (THEME_INIT("gridNowColor") ? THEME_COLOR("gridNowColor") : TLINE_BOX_COLOR)
+#define GRID_PROGRESS_COLOR      (THEME_INIT("gridProgressColor") ? THEME_COLOR("gridProgressColor") : GRID_SEP_COLOR)
 #define EVENT_TITLE_COLOR        THEME_COLOR("eventTitleColor")
 #define EVENT_INFO_COLOR         THEME_COLOR("eventInfoColor")
 #define EVENT_TIME_COLOR         THEME_COLOR("eventTimeColor")
@@ -67,6 +76,8 @@
 #define LEFT_ARROW_WIDTH         THEME_IVAL("leftArrowWidth")
 #define RIGHT_ARROW_WIDTH        THEME_IVAL("rightArrowWidth")
 #define GRID_HORIZ_SPACE         THEME_IVAL("gridHorizSpace")
+#define GRID_VERTICAL            (THEME_INIT("gridVertical") ? THEME_IVAL("gridVertical") : 0)
+#define GRID_PROGRESS_HEIGHT     (THEME_INIT("gridProgressHeight") ? THEME_IVAL("gridProgressHeight") : 3)
 #define TEXT_BORDER              THEME_IVAL("textBorder")
 #define TEXT_SPACE               THEME_IVAL("textSpace")
 #define EVENT_INFO_ALIGN         THEME_IVAL("eventInfoAlign")
@@ -101,6 +112,11 @@ struct tGeom {
    int h;
 };
 
+class cYaepgGridLayout;
+class cYaepgLogoAtlas;
+
+void CopyBitmapRect(cBitmap *dst, const cBitmap *src, const tGeom &g);
+
 
 /*
  *****************************************************************************
@@ -129,6 +145,10 @@ class cFontSymbols
 /*
  *****************************************************************************
  * cYaepgTheme
+ *
+ * There is only one theme, loaded by the guide when it opens.  The SVDRP
+ * benchmark draws with it from another thread, so the two claim it with
+ * Acquire()/Release() and never run at the same time.
  *****************************************************************************
  */
 class cYaepgTheme {
@@ -157,6 +177,9 @@ public:
 
 private:
    static cYaepgTheme *instance;
+   static cMutex useMutex;
+   static int guides;
+   static bool benchmark;
 
    std::map< std::string, tThemeElement > themeMap;
    std::vector< cBitmap * > themeImages;
@@ -179,6 +202,8 @@ private:
 public:
    static cYaepgTheme *Instance(void);
    static void Destroy(void);
+   static bool Acquire(bool exclusive);
+   static void Release(bool exclusive);
    bool Load(std::string Theme);
    static void Themes(char ***_themes, int *_numThemes);
    tThemeElement Element(const char *name) { return themeMap[std::string(name)]; }
@@ -217,14 +242,12 @@ private:
    tColor fgColor;
    tColor bgColor;
    cBitmap *bgImage;
-   cBitmap *bitmap;
    eTextFlags flags;
    tGeom geom;
    std::vector< sTextLine > fmtText;
 
 public:
    cYaepgTextBox(void);
-   ~cYaepgTextBox() { delete bitmap; }
    void Text(const char *_text) { text.assign(_text); }
    void Font(cFont *_font) { font = _font; }
    void Flags(eTextFlags _flags) { flags = _flags; }
@@ -241,6 +264,8 @@ public:
    int Y(void) { return geom.y; }
    int W(void) { return geom.w; }
    int H(void) { return geom.h; }
+   void Offset(int dx, int dy);
+   void Swap(cYaepgTextBox &other);
    void Generate(void);
    void Draw(cBitmap *bmp);
 };
@@ -248,6 +273,90 @@ public:
 
 
 
+/*
+ *****************************************************************************
+ * cYaepgGridCells
+ *
+ * Flat storage for the cells of the event grid.  The cells of all rows are
+ * kept in contiguous structure-of-arrays form (geometry, flags and event
+ * handle per cell) with rowStart[] pointing at the first cell of each row.
+ * The text layout of each cell lives in a separate store with the same
+ * indexes so that geometry walks don't have to touch the text boxes.  Clear()
+ * keeps the allocated capacity, so regenerating the grid doesn't allocate.
+ *****************************************************************************
+ */
+enum eCellFlags {
+   CELL_ARROW_LEFT      = 0x0001,
+   CELL_ARROW_RIGHT     = 0x0002,
+   CELL_TIMER           = 0x0004,
+   CELL_TIMER_PARTIAL   = 0x0008,
+   CELL_RECORDING       = 0x0010,
+   CELL_VPS             = 0x0020,
+   CELL_BADGES          = 0x003C,
+   CELL_GENRE           = 0x0F00
+};
+
+#define CELL_BADGE_SHIFT         2
+#define CELL_BADGE_COMBOS        16
+#define CELL_GENRE_SHIFT         8
+#define CELL_GENRES              16
+
+class cYaepgGridCells {
+private:
+   std::vector< int > rowStart;
+   std::vector< const cChannel * > rowChans;
+   std::vector< tGeom > geoms;
+   std::vector< uint16_t > flags;
+   std::vector< tEventSnap > events;
+   std::vector< cYaepgTextBox > boxes;
+   int numCells;
+
+public:
+   cYaepgGridCells(void) : numCells(0) {}
+   void Reserve(int rows, int cellsPerRow);
+   void Clear(void);
+   void Swap(cYaepgGridCells &other);
+   void AddRow(const cChannel *chan) { rowStart.push_back(numCells); rowChans.push_back(chan); }
+   int AddCell(const tEventSnap &event, uint16_t cellFlags, const tGeom &geom);
+   int FindRow(const cChannel *chan) const;
+   void TakeRow(cYaepgGridCells &from, int row, int dx, int dy);
+   int Rows(void) const { return rowStart.size(); }
+   int First(int row) const { return rowStart[row]; }
+   int End(int row) const { return (row + 1 < (int)rowStart.size()) ? rowStart[row + 1] : numCells; }
+   int Cols(int row) const { return End(row) - First(row); }
+   int Index(int row, int col) const { return rowStart[row] + col; }
+   int ColAt(int row, int pos, const cYaepgGridLayout *layout) const;
+   const tGeom &Geom(int cell) const { return geoms[cell]; }
+   uint16_t Flags(int cell) const { return flags[cell]; }
+   const tEventSnap &Event(int cell) const { return events[cell]; }
+   cYaepgTextBox &Box(int cell) { return boxes[cell]; }
+   const cChannel *RowChan(int row) const { return rowChans[row]; }
+   const tEventSnap *RowEvents(int row) const { return &events[rowStart[row]]; }
+   uint16_t *RowFlags(int row) { return &flags[rowStart[row]]; }
+};
+
+/*
+ *****************************************************************************
+ * tSelEvent
+ *
+ * The selected event as the event widgets show it: the index entry, the
+ * channel it belongs to and the description, all copied while the schedules
+ * were locked.  Where VDR needs the cEvent itself (timers, switch timers) it
+ * is looked up again with Find() under the schedules lock and only used
+ * while that is held.  Entries without EPG data have an id of 0 and are
+ * never found.
+ *****************************************************************************
+ */
+struct tSelEvent {
+   tChannelID channel;
+   tEventSnap event;
+   std::string description;
+
+   tSelEvent(void);
+   const cEvent *Find(const cSchedules *Schedules) const;
+   bool Same(const tSelEvent &other) const;
+};
+
 /*
  *****************************************************************************
  * cYaepgGrid
@@ -262,49 +371,185 @@ enum eCursorDir {
 
 class cYaepgGrid {
 private:
-   class cNoInfoEvent : public cEvent {
-   private:
-      time_t startTime;
-
-   public:
-      cNoInfoEvent(time_t);
-   };
-
-   struct tYaepgEvent {
-      const cEvent *event;
-      cYaepgTextBox box;
-   };
-
-   cYaepgTextBox leftBox;
-   cYaepgTextBox rightBox;
-
    tGeom geom;
    int startTime;
-   int horizSpace;
-   float gridRowHeight;
-   float gridPixPerMin;
-   std::vector< cChannel * > &chanVec;
-   std::vector< std::vector< tYaepgEvent > > events;
+   const cYaepgGridLayout *layout;
+   std::vector< const cChannel * > &chanVec;
+   cYaepgGridCells cells;
+   cYaepgGridCells prevCells;
+   time_t cacheStart;
+   int cacheVersion;
+   std::vector< const cChannel * > cacheChans;
+   cYaepgStateKeys stateKeys;
+   int badgeVersion;
+   std::string badgeText[CELL_BADGE_COMBOS];
+   int badgeWidth[CELL_BADGE_COMBOS];
+   tColor genreBg[CELL_GENRES];
    std::vector< cYaepgTextBox > leftArrows;
    std::vector< cYaepgTextBox > rightArrows;
-   std::vector< const cEvent * > noInfoEvents;
+   std::vector< std::vector< tEventSnap > > rowSnaps;
+   time_t nowTime;
    int curX;
    int curY;
 
    void FixCursor(void);
+   void InitBadges(void);
+   void InitGenres(void);
+   int BadgeWidth(int cell);
+   int TimePos(time_t t);
+   bool Running(int cell, time_t t);
+   void DrawCell(cBitmap *bmp, int cell, bool sel);
+   void DrawSeparator(cBitmap *bmp, int cell);
+   void GenerateRow(int row, const std::vector< tEventSnap > &snaps, time_t gridStart);
 
 public:
-   cYaepgGrid(std::vector< cChannel * > &chans, int time);
-   ~cYaepgGrid();
+   cYaepgGrid(std::vector< const cChannel * > &chans, int time);
    void UpdateTime(time_t newTime) { startTime = newTime; Generate(); }
-   void UpdateChans(std::vector< cChannel * > &chans) { chanVec = chans; Generate(); }
+   void UpdateChans(std::vector< const cChannel * > &chans) { chanVec = chans; Generate(); }
    bool MoveCursor(eCursorDir dir);
-   const cEvent *Event(void) { return events[curY][curX].event; }
+   bool Vertical(void);
+   tSelEvent Event(void);
    void Row(int row);
    void Col(int col);
+   void Select(int row, time_t t);
    int Row(void) { return curY; }
    int Col(void) { return curX; }
    void Generate(void);
+   void UpdateBadges(void);
+   void Tick(time_t now, cBitmap *bmp, std::vector< tGeom > &dirty);
+   bool NowGeom(tGeom &g);
+   void Draw(cBitmap *bmp);
+};
+
+
+/*
+ *****************************************************************************
+ * cYaepgWeekView
+ *
+ * One fixed time slot (e.g. 20:15) on each of the next seven days for the
+ * visible channels.  The slots are filled from the EPG index, each one a
+ * lookup in the half hour buckets of its channel, and the event is only
+ * looked up in the schedules again when it is selected.  The cells are
+ * placed with the grid layout, using one slot per day on the time axis.
+ *****************************************************************************
+ */
+#define WEEK_DAYS                7
+
+class cYaepgWeekView {
+private:
+   tGeom geom;
+   const cYaepgGridLayout *layout;
+   const cYaepgGridLayout *dayLayout;
+   std::vector< const cChannel * > &chanVec;
+   int slotTime;
+   time_t slots[WEEK_DAYS];
+   cYaepgTextBox days[WEEK_DAYS];
+   std::vector< tEventSnap > events;
+   std::vector< cYaepgTextBox > boxes;
+   int curX;
+   int curY;
+
+   void FillRow(int row, const cYaepgEpgSnapshot *epg);
+
+public:
+   cYaepgWeekView(std::vector< const cChannel * > &chans, int _slotTime);
+   void UpdateChans(std::vector< const cChannel * > &chans) { chanVec = chans; Generate(); }
+   bool MoveCursor(eCursorDir dir);
+   tSelEvent Event(void);
+   time_t Time(void) { return slots[curX]; }
+   void Row(int row);
+   int Row(void) { return curY; }
+   void Generate(void);
+   void Draw(cBitmap *bmp);
+};
+
+
+
+/*
+ *****************************************************************************
+ * cYaepgNowNextView
+ *
+ * Present and following event of all channels, one channel per grid row.
+ * The list is built in one go, scrolling only moves the window over it and
+ * reuses the rows that stay visible.
+ *****************************************************************************
+ */
+class cYaepgNowNextView {
+private:
+   struct tNowNextRow {
+      int entry;
+      cYaepgTextBox chanBox;
+      cYaepgTextBox nowBox;
+      cYaepgTextBox nextBox;
+   };
+
+   tGeom geom;
+   const cYaepgGridLayout *layout;
+   const cYaepgGridLayout *chanLayout;
+   const cYaepgGridLayout *headLayout;
+   cYaepgNowNext list;
+   cYaepgTextBox heads[2];
+   std::vector< tNowNextRow > rows;
+   std::vector< tNowNextRow > prevRows;
+   int top;
+   int cur;
+   time_t nowTime;
+
+   void GenerateRow(tNowNextRow &r, int row);
+   void Generate(void);
+
+public:
+   cYaepgNowNextView(const cChannel *chan);
+   void Update(void);
+   void MoveCursor(int change);
+   const cChannel *Channel(void);
+   tSelEvent Event(void);
+   void Draw(cBitmap *bmp);
+};
+
+
+
+/*
+ *****************************************************************************
+ * cYaepgSearchView
+ *
+ * Search over the titles, short texts and descriptions in the EPG index.
+ * The query is typed with the number keys like on a phone, the matching
+ * events are searched again once no key has been pressed for a moment and
+ * listed one per row.
+ *****************************************************************************
+ */
+#define SEARCH_MAX_HITS          200
+#define SEARCH_TAP_MS            1000
+#define SEARCH_DELAY_MS          500
+
+class cYaepgSearchView {
+private:
+   tGeom geom;
+   const cYaepgGridLayout *layout;
+   std::string query;
+   int lastKey;
+   int tap;
+   cTimeMs tapTimeout;
+   bool searchPending;
+   cTimeMs searchDelay;
+   cYaepgTextBox queryBox;
+   std::vector< tSearchHit > hits;
+   std::vector< cYaepgTextBox > boxes;
+   int top;
+   int cur;
+
+   void Search(void);
+   void GenerateQuery(void);
+   void GenerateRows(void);
+
+public:
+   cYaepgSearchView(void);
+   bool ProcessInput(eKeys key);
+   bool Poll(void);
+   void MoveCursor(int change);
+   const tSearchHit *Hit(void) { return hits.empty() ? NULL : &hits[cur]; }
+   tSelEvent Event(void);
    void Draw(cBitmap *bmp);
 };
 
@@ -318,20 +563,24 @@ public:
 class cYaepgGridChans {
 private:
    struct tYaepgChan {
-      cChannel *c;
+      const cChannel *c;
+      int logo;
+      tGeom logoGeom;
       cYaepgTextBox numBox;
       cYaepgTextBox nameBox;
    };
 
    tGeom geom;
-   std::vector< cChannel * > &chanVec;
+   std::vector< const cChannel * > &chanVec;
    std::vector< tYaepgChan > chanInfo;
-   float chanRowHeight;
-   int horizSpace;
+   std::vector< tYaepgChan > prevChanInfo;
+   const cYaepgGridLayout *layout;
+   cYaepgLogoAtlas *logos;
+   int logoSize;
 
 public:
-   cYaepgGridChans(std::vector< cChannel * > &chans);
-   void UpdateChans(std::vector< cChannel * > &chans) { chanVec = chans; Generate(); }
+   cYaepgGridChans(std::vector< const cChannel * > &chans);
+   void UpdateChans(std::vector< const cChannel * > &chans) { chanVec = chans; Generate(); }
    void Generate(void);
    void Draw(cBitmap *bmp);
 };
@@ -349,6 +598,7 @@ private:
    time_t startTime;
    std::vector< cYaepgTextBox > times;
    tGeom geom;
+   const cYaepgGridLayout *layout;
 
 public:
    cYaepgGridTime(time_t _startTime);
@@ -391,12 +641,12 @@ public:
 class cYaepgEventTitle {
 private:
    tGeom geom;
-   const cEvent *event;
+   tSelEvent event;
    cYaepgTextBox box;
 
 public:
-   cYaepgEventTitle(const cEvent *_event);
-   void UpdateEvent(const cEvent *_event) { event = _event; Generate(); }
+   cYaepgEventTitle(const tSelEvent &_event);
+   void UpdateEvent(const tSelEvent &_event) { event = _event; Generate(); }
    void Generate(void);
    void Draw(cBitmap *bmp);
 };
@@ -411,12 +661,15 @@ public:
 class cYaepgEventInfo {
 private:
    tGeom geom;
-   const cEvent *event;
+   tSelEvent event;
+   tSelEvent genEvent;
+   bool generated;
+   cYaepgStateKeys stateKeys;
    cYaepgTextBox boxes[3];
 
 public:
-   cYaepgEventInfo(const cEvent *_event);
-   void UpdateEvent(const cEvent *_event) { event = _event; Generate(); }
+   cYaepgEventInfo(const tSelEvent &_event);
+   void UpdateEvent(const tSelEvent &_event) { event = _event; Generate(); }
    void Generate(void);
    void Draw(cBitmap *bmp);
 };
@@ -431,13 +684,19 @@ public:
 class cYaepgEventEpgImage {
 private:
    tGeom geom;
-   const cEvent *event;
-   cBitmap *EpgImage;
+   tEventID eventId;
+   cYaepgImageJob *job;
+   cYaepgImage *image;
+
+   void Clear(void);
 
 public:
-   cYaepgEventEpgImage(const cEvent *_event);
-   void UpdateEvent(const cEvent *_event) { event = _event; Generate(); }
+   cYaepgEventEpgImage(tEventID _eventId);
+   ~cYaepgEventEpgImage();
+   void UpdateEvent(tEventID _eventId) { eventId = _eventId; Generate(); }
    void Generate(void);
+   bool Poll(void);
+   tGeom Geom(void) const { return geom; }
    void Draw(cBitmap *bmp);
 };
 
@@ -450,13 +709,13 @@ public:
  */
 class cYaepgEventTime {
 private:
-   const cEvent *event;
+   tSelEvent event;
    cYaepgTextBox box;
    tGeom geom;
 
 public:
-   cYaepgEventTime(const cEvent *_event);
-   void UpdateEvent(const cEvent *_event) { event = _event; Generate(); }
+   cYaepgEventTime(const tSelEvent &_event);
+   void UpdateEvent(const tSelEvent &_event) { event = _event; Generate(); }
    void Generate(void);
    void Draw(cBitmap *bmp);
 };
@@ -470,13 +729,13 @@ public:
  */
 class cYaepgEventDesc {
 private:
-   const cEvent *event;
+   tSelEvent event;
    cYaepgTextBox box;
    tGeom geom;
 
 public:
-   cYaepgEventDesc(const cEvent *_event);
-   void UpdateEvent(const cEvent *_event) { event = _event; Generate(); }
+   cYaepgEventDesc(const tSelEvent &_event);
+   void UpdateEvent(const tSelEvent &_event) { event = _event; Generate(); }
    void Generate(void);
    void Draw(cBitmap *bmp);
 };
@@ -512,15 +771,17 @@ private:
    tGeom boxGeom;
    tColor boxColor;
    time_t startTime;
-   float pixPerMin;
-   int xOff;
+   const cYaepgGridLayout *layout;
+   tGeom box;
    bool hidden;
 
 public:
    cYaepgTimeLine(time_t _startTime);
    void UpdateTime(time_t _startTime);
    void Generate(void);
+   bool Geom(tGeom &g);
    void Draw(cBitmap *bmp);
+   void Draw(cOsd *osd);
 };
 
 
@@ -585,7 +846,7 @@ public:
  */
 class cYaepgRecDlg {
 private:
-   const cEvent *event;
+   tSelEvent event;
    tGeom geom;
    cYaepgTextBox titleBox;
    cYaepgTextBox timeBox;
@@ -597,7 +858,7 @@ private:
 
 public:
    cYaepgRecDlg(void);
-   void UpdateEvent(const cEvent *_event);
+   void UpdateEvent(const tSelEvent &_event);
    eOSState ProcessKey(eKeys key);
    void Draw(cBitmap *bmp);
    bool AddTimer(void);
@@ -0,0 +1,229 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#include "ImageIndex.h"
+
+#include "MenuSetupYaepg.h"
+#include "Utils.h"
+
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define IMAGE_POLL_MS            1000
+#define IMAGE_RESCAN_MS          (60 * 1000)
+#define IMAGE_WATCH_MASK         (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+
+/*
+ *****************************************************************************
+ * cYaepgImageIndex
+ *****************************************************************************
+ */
+cYaepgImageIndex *cYaepgImageIndex::instance = NULL;
+
+cYaepgImageIndex::cYaepgImageIndex(void) :
+   cThread("yaepghd image index", true),
+   scanned(false)
+{
+}
+
+cYaepgImageIndex::~cYaepgImageIndex()
+{
+   Cancel(-1);
+   wakeup.Signal();
+   Cancel(3);
+}
+
+cYaepgImageIndex *
+cYaepgImageIndex::Instance(void)
+{
+   if (instance == NULL) {
+      instance = new cYaepgImageIndex;
+      instance->Start();
+   }
+   return instance;
+}
+
+void
+cYaepgImageIndex::Destroy(void)
+{
+   delete instance;
+   instance = NULL;
+}
+
+/*
+ * Splits an image file name into event id and extension.
+ */
+bool
+cYaepgImageIndex::Parse(const char *name, tEventID &event, std::string &ext)
+{
+   unsigned int id;
+   char suffix[8];
+
+   if (sscanf(name, "%u.%7s", &id, suffix) != 2 || strchr(suffix, '.') != NULL) {
+      return false;
+   }
+   event = id;
+   ext = suffix;
+   return true;
+}
+
+/*
+ * Reads the whole directory, the new list replaces the old one at once.
+ */
+void
+cYaepgImageIndex::Scan(void)
+{
+   std::map< std::string, time_t > found;
+   DIR *dir = opendir(sEpgImagesDir.c_str());
+   struct dirent *e;
+
+   if (dir != NULL) {
+      while ((e = readdir(dir)) != NULL) {
+         tEventID event;
+         std::string ext;
+         struct stat st;
+
+         if (Parse(e->d_name, event, ext) &&
+             stat(AddDirectory(sEpgImagesDir.c_str(), e->d_name), &st) == 0 && S_ISREG(st.st_mode)) {
+            found[e->d_name] = st.st_mtime;
+         }
+      }
+      closedir(dir);
+   }
+
+   YAEPG_INFO("Found %d epg images in %s", (int)found.size(), sEpgImagesDir.c_str());
+
+   mutex.Lock();
+   files.swap(found);
+   scanned = true;
+   mutex.Unlock();
+}
+
+void
+cYaepgImageIndex::Update(const char *name, bool removed)
+{
+   tEventID event;
+   std::string ext;
+   struct stat st;
+
+   if (!Parse(name, event, ext)) {
+      return;
+   }
+
+   cMutexLock lock(&mutex);
+   if (!removed && stat(AddDirectory(sEpgImagesDir.c_str(), name), &st) == 0 && S_ISREG(st.st_mode)) {
+      files[name] = st.st_mtime;
+   } else {
+      files.erase(name);
+   }
+}
+
+void
+cYaepgImageIndex::Action(void)
+{
+   int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   int wd = -1;
+   bool rescan = false;
+
+   if (fd < 0) {
+      YAEPG_ERROR("Can't watch %s, reading it every minute", sEpgImagesDir.c_str());
+   }
+
+   while (Running()) {
+      if (wd < 0) {
+         if (fd >= 0) {
+            wd = inotify_add_watch(fd, sEpgImagesDir.c_str(), IMAGE_WATCH_MASK);
+         }
+         Scan();
+         if (wd < 0) {
+            wakeup.Wait(IMAGE_RESCAN_MS);
+            continue;
+         }
+      } else if (rescan) {
+         Scan();
+      }
+      rescan = false;
+
+      struct pollfd pfd = { fd, POLLIN, 0 };
+      if (poll(&pfd, 1, IMAGE_POLL_MS) <= 0) {
+         continue;
+      }
+
+      char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+      ssize_t len;
+      while ((len = read(fd, buf, sizeof(buf))) > 0) {
+         for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->mask & IN_Q_OVERFLOW) {
+               rescan = true;
+            } else if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+               // directory gone, watch it again once it's back
+               if (ev->wd == wd) {
+                  if (!(ev->mask & IN_IGNORED)) {
+                     inotify_rm_watch(fd, wd);
+                  }
+                  wd = -1;
+               }
+            } else if (ev->len > 0) {
+               Update(ev->name, ev->mask & (IN_DELETE | IN_MOVED_FROM));
+            }
+            p += sizeof(struct inotify_event) + ev->len;
+         }
+      }
+   }
+
+   if (fd >= 0) {
+      close(fd);
+   }
+}
+
+/*
+ * Returns whether the image of an event exists, and its mtime if it does.
+ */
+bool
+cYaepgImageIndex::Find(tEventID event, const char *ext, time_t &mtime)
+{
+   cMutexLock lock(&mutex);
+   std::map< std::string, time_t >::const_iterator it = files.find(*cString::sprintf("%u.%s", (unsigned int)event, ext));
+
+   if (it == files.end()) {
+      return false;
+   }
+   mtime = it->second;
+   return true;
+}
+
+/*
+ * All images with the given extension, or with any extension if it is NULL.
+ */
+std::vector< tImageFile >
+cYaepgImageIndex::Files(const char *ext)
+{
+   cMutexLock lock(&mutex);
+   std::vector< tImageFile > list;
+
+   for (std::map< std::string, time_t >::const_iterator it = files.begin(); it != files.end(); ++it) {
+      tEventID event;
+      std::string e;
+      if (Parse(it->first.c_str(), event, e) && (ext == NULL || e == ext)) {
+         tImageFile f = { event, it->second };
+         list.push_back(f);
+      }
+   }
+   return list;
+}
+
+bool
+cYaepgImageIndex::Scanned(void)
+{
+   cMutexLock lock(&mutex);
+   return scanned;
+}
@@ -0,0 +1,60 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <vdr/epg.h>
+#include <vdr/thread.h>
+
+/*
+ *****************************************************************************
+ * cYaepgImageIndex
+ *
+ * The EPG images available in the image directory, so the image widget only
+ * submits events which actually have an image instead of failing to open a
+ * file on every cursor move.  A background thread reads the directory once
+ * and then follows it with inotify; files are named <event id>.<extension>
+ * and recorded with their mtime.  If the directory can't be watched it's
+ * read again every minute.  Until the directory has been read once the
+ * list is empty, Scanned() tells the two apart.
+ *****************************************************************************
+ */
+struct tImageFile {
+   tEventID event;
+   time_t mtime;
+};
+
+class cYaepgImageIndex : public cThread {
+private:
+   static cYaepgImageIndex *instance;
+
+   cMutex mutex;
+   cCondWait wakeup;
+   std::map< std::string, time_t > files;
+   bool scanned;
+
+   cYaepgImageIndex(void);
+   ~cYaepgImageIndex();
+   static bool Parse(const char *name, tEventID &event, std::string &ext);
+   void Scan(void);
+   void Update(const char *name, bool removed);
+
+protected:
+   virtual void Action(void);
+
+public:
+   static cYaepgImageIndex *Instance(void);
+   static void Destroy(void);
+   bool Find(tEventID event, const char *ext, time_t &mtime);
+   std::vector< tImageFile > Files(const char *ext = NULL);
+   bool Scanned(void);
+};
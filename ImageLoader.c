@@ -0,0 +1,961 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#include "ImageLoader.h"
+
+#include "ImageIndex.h"
+#include "MenuSetupYaepg.h"
+#include "Utils.h"
+
+#include <Magick++.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBJPEG
+#include <jpeglib.h>
+#include <setjmp.h>
+#endif
+#ifdef HAVE_LIBPNG
+#include <png.h>
+#endif
+
+#define MAX_WORKERS              2
+#define IMAGE_CACHE_SIZE         32
+#define THUMB_SCAN_MS            (5 * 60 * 1000)
+
+/*
+ *****************************************************************************
+ * cYaepgImageWorker
+ *****************************************************************************
+ */
+class cYaepgImageWorker : public cThread {
+private:
+   cYaepgImageLoader *loader;
+
+protected:
+   virtual void Action(void);
+
+public:
+   cYaepgImageWorker(cYaepgImageLoader *_loader);
+   bool Working(void) { return Running(); }
+   void Stop(void) { Cancel(-1); }
+   ~cYaepgImageWorker() { Cancel(3); }
+};
+
+cYaepgImageWorker::cYaepgImageWorker(cYaepgImageLoader *_loader) :
+   cThread("yaepghd image loader"),
+   loader(_loader)
+{
+   Start();
+}
+
+void
+cYaepgImageWorker::Action(void)
+{
+   loader->Work(this);
+}
+
+/*
+ *****************************************************************************
+ * cYaepgThumbIndexer
+ *
+ * Creates the missing thumbnails of all images in the image directory for
+ * one widget size, checking again every few minutes for new images.  Before
+ * that the thumbnails of removed or changed images are deleted.  Other VDR
+ * instances may share the directory with other themes, resize modes or
+ * image extensions, so thumbnails of other sizes are only deleted along
+ * with their image.
+ *****************************************************************************
+ */
+class cYaepgThumbIndexer : public cThread {
+private:
+   int width;
+   int height;
+   int mode;
+   cCondWait wakeup;
+
+   void Prune(const std::vector< tImageFile > &files);
+   void Scan(void);
+
+protected:
+   virtual void Action(void);
+
+public:
+   cYaepgThumbIndexer(int _width, int _height, int _mode);
+   ~cYaepgThumbIndexer();
+   bool Matches(int _width, int _height, int _mode) const { return width == _width && height == _height && mode == _mode; }
+};
+
+cYaepgThumbIndexer::cYaepgThumbIndexer(int _width, int _height, int _mode) :
+   cThread("yaepghd thumbnails", true),
+   width(_width),
+   height(_height),
+   mode(_mode)
+{
+   Start();
+}
+
+cYaepgThumbIndexer::~cYaepgThumbIndexer()
+{
+   Cancel(-1);
+   wakeup.Signal();
+   Cancel(3);
+}
+
+/*
+ * The images of all extensions count, a thumbnail is kept as long as one
+ * image of its event is as old as the one it was made from.  Files of an
+ * older format are never read again and go as well.
+ */
+void
+cYaepgThumbIndexer::Prune(const std::vector< tImageFile > &files)
+{
+   std::map< tEventID, time_t > mtimes;
+   DIR *dir = opendir(sThumbDir.c_str());
+   struct dirent *e;
+   int removed = 0;
+
+   if (dir == NULL) {
+      return;
+   }
+   for (int i = 0; i < (int)files.size(); i++) {
+      std::map< tEventID, time_t >::iterator it = mtimes.find(files[i].event);
+      if (it == mtimes.end() || files[i].mtime < it->second) {
+         mtimes[files[i].event] = files[i].mtime;
+      }
+   }
+
+   while (Running() && (e = readdir(dir)) != NULL) {
+      tThumbFileHeader h;
+      unsigned int event;
+      int width, height, mode;
+      int len = 0;
+
+      /* Temporary files of other writers don't match */
+      if (sscanf(e->d_name, "%u-%dx%d-%d.thm%n", &event, &width, &height, &mode, &len) != 4 ||
+          len == 0 || e->d_name[len] != '\0') {
+         continue;
+      }
+      cString name = AddDirectory(sThumbDir.c_str(), e->d_name);
+      if (!cYaepgImageLoader::ThumbHeader(name, h)) {
+         continue;
+      }
+      std::map< tEventID, time_t >::const_iterator it = mtimes.find(event);
+      bool stale = h.version < THUMB_FILE_VERSION ||
+                   (h.version == THUMB_FILE_VERSION && (it == mtimes.end() || (int64_t)it->second > h.mtime));
+      if (stale && unlink(name) == 0) {
+         removed++;
+      }
+   }
+   closedir(dir);
+
+   YAEPG_INFO("Removed %d stale thumbnails", removed);
+}
+
+void
+cYaepgThumbIndexer::Scan(void)
+{
+   const char *ext = imageExtensionTexts[iImageExtension];
+   cYaepgImageIndex *index = cYaepgImageIndex::Instance();
+   std::vector< tImageFile > files = index->Files(ext);
+   int made = 0;
+
+   /* An empty list before the image directory has been read says nothing */
+   if (index->Scanned()) {
+      Prune(index->Files());
+   }
+
+   for (int i = 0; Running() && i < (int)files.size(); i++) {
+      tImageKey key = { files[i].event, files[i].mtime, width, height, mode };
+      std::vector< tColor > pixels;
+      std::vector< tColor > palette;
+      std::vector< tIndex > indexes;
+
+      if (cYaepgImageLoader::ThumbValid(key)) {
+         continue;
+      }
+      cString file = cString::sprintf("%s/%u.%s", sEpgImagesDir.c_str(), (unsigned int)files[i].event, ext);
+      if (cYaepgImageLoader::Decode(file, width, height, mode, NULL, pixels) &&
+          cYaepgImageLoader::Palettize(pixels, palette, indexes)) {
+         cYaepgImageLoader::WriteThumb(key, palette, indexes);
+         made++;
+      }
+   }
+
+   YAEPG_INFO("Created %d thumbnails of %dx%d", made, width, height);
+}
+
+void
+cYaepgThumbIndexer::Action(void)
+{
+   while (Running()) {
+      Scan();
+      wakeup.Wait(THUMB_SCAN_MS);
+   }
+}
+
+/*
+ *****************************************************************************
+ * cYaepgImageCache
+ *****************************************************************************
+ */
+bool
+tImageKey::operator<(const tImageKey &other) const
+{
+   if (event != other.event) {
+      return event < other.event;
+   }
+   if (mtime != other.mtime) {
+      return mtime < other.mtime;
+   }
+   if (width != other.width) {
+      return width < other.width;
+   }
+   if (height != other.height) {
+      return height < other.height;
+   }
+   return mode < other.mode;
+}
+
+cYaepgImageCache::cYaepgImageCache(int _size) :
+   size(_size),
+   hits(0),
+   misses(0)
+{
+}
+
+cYaepgImageCache::~cYaepgImageCache()
+{
+   for (tImageList::iterator it = images.begin(); it != images.end(); it++) {
+      it->second->Unref();
+   }
+}
+
+/*
+ * Returns the image with a reference taken, NULL if it isn't cached.
+ */
+cYaepgImage *
+cYaepgImageCache::Get(const tImageKey &key)
+{
+   cMutexLock lock(&mutex);
+
+   std::map< tImageKey, tImageList::iterator >::iterator it = index.find(key);
+   if (it == index.end()) {
+      misses++;
+      return NULL;
+   }
+   hits++;
+   images.splice(images.begin(), images, it->second);
+   it->second->second->Ref();
+   return it->second->second;
+}
+
+void
+cYaepgImageCache::Put(const tImageKey &key, cYaepgImage *image)
+{
+   cMutexLock lock(&mutex);
+
+   if (index.find(key) != index.end()) {
+      return;
+   }
+   image->Ref();
+   images.push_front(std::make_pair(key, image));
+   index[key] = images.begin();
+   if ((int)images.size() > size) {
+      index.erase(images.back().first);
+      images.back().second->Unref();
+      images.pop_back();
+   }
+}
+
+cString
+cYaepgImageCache::Stats(void)
+{
+   cMutexLock lock(&mutex);
+
+   return cString::sprintf("%d of %d images cached, %d hits, %d misses",
+                           (int)images.size(), size, hits, misses);
+}
+
+/*
+ *****************************************************************************
+ * cYaepgImageJob
+ *****************************************************************************
+ */
+cYaepgImageJob::cYaepgImageJob(const tImageKey &_key, const char *_file) :
+   refs(1),
+   key(_key),
+   file(_file),
+   cancelled(false),
+   done(false),
+   image(NULL)
+{
+}
+
+cYaepgImageJob::~cYaepgImageJob()
+{
+   if (image != NULL) {
+      image->Unref();
+   }
+}
+
+void
+cYaepgImageJob::Finish(cYaepgImage *_image)
+{
+   cMutexLock lock(&mutex);
+
+   image = _image;
+   done = true;
+}
+
+void
+cYaepgImageJob::Cancel(void)
+{
+   cMutexLock lock(&mutex);
+
+   cancelled = true;
+}
+
+bool
+cYaepgImageJob::Cancelled(void) const
+{
+   cMutexLock lock(&mutex);
+
+   return cancelled;
+}
+
+bool
+cYaepgImageJob::Done(void) const
+{
+   cMutexLock lock(&mutex);
+
+   return done;
+}
+
+/*
+ * Returns the decoded image, NULL if there is none or the job isn't done
+ * yet.  The job keeps its reference, Ref() it to keep the image longer.
+ */
+cYaepgImage *
+cYaepgImageJob::Image(void) const
+{
+   cMutexLock lock(&mutex);
+
+   return done ? image : NULL;
+}
+
+/*
+ *****************************************************************************
+ * cYaepgImageLoader
+ *****************************************************************************
+ */
+cYaepgImageLoader *cYaepgImageLoader::instance = NULL;
+
+cYaepgImageLoader::cYaepgImageLoader(void) :
+   cache(IMAGE_CACHE_SIZE),
+   indexer(NULL)
+{
+   int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+   for (int i = 0; i < MAX(MIN(cpus - 1, MAX_WORKERS), 1); i++) {
+      workers.push_back(new cYaepgImageWorker(this));
+   }
+}
+
+cYaepgImageLoader::~cYaepgImageLoader()
+{
+   delete indexer;
+   for (int i = 0; i < (int)workers.size(); i++) {
+      workers[i]->Stop();
+   }
+   mutex.Lock();
+   jobCond.Broadcast();
+   mutex.Unlock();
+   for (int i = 0; i < (int)workers.size(); i++) {
+      delete workers[i];
+   }
+   for (int i = 0; i < (int)jobs.size(); i++) {
+      jobs[i]->Unref();
+   }
+}
+
+cYaepgImageLoader *
+cYaepgImageLoader::Instance(void)
+{
+   if (instance == NULL) {
+      instance = new cYaepgImageLoader;
+   }
+   return instance;
+}
+
+void
+cYaepgImageLoader::Destroy(void)
+{
+   delete instance;
+   instance = NULL;
+}
+
+/*
+ * Queues the image of an event for decoding and returns the job with a
+ * reference taken, the caller has to Unref() it when done.  The mtime of
+ * the image comes from the image index.
+ */
+cYaepgImageJob *
+cYaepgImageLoader::Submit(tEventID event, time_t mtime, const char *file, int width, int height, int mode)
+{
+   tImageKey key = { event, mtime, width, height, mode };
+   cYaepgImageJob *job = new cYaepgImageJob(key, file);
+   job->Ref();
+
+   cYaepgImage *image = cache.Get(key);
+   if (image != NULL) {
+      job->Finish(image);
+      return job;
+   }
+
+   mutex.Lock();
+   jobs.push_back(job);
+   jobCond.Broadcast();
+   mutex.Unlock();
+
+   return job;
+}
+
+/*
+ * Waits for the next job which hasn't been cancelled, NULL when the worker
+ * is stopped.  Cancelled jobs are finished without an image.
+ */
+cYaepgImageJob *
+cYaepgImageLoader::Next(cYaepgImageWorker *worker)
+{
+   cMutexLock lock(&mutex);
+
+   while (worker->Working()) {
+      if (jobs.empty()) {
+         jobCond.Wait(mutex);
+         continue;
+      }
+      cYaepgImageJob *job = jobs.front();
+      jobs.pop_front();
+      if (!job->Cancelled()) {
+         return job;
+      }
+      job->Finish(NULL);
+      job->Unref();
+   }
+   return NULL;
+}
+
+void
+cYaepgImageLoader::Work(cYaepgImageWorker *worker)
+{
+   cYaepgImageJob *job;
+
+   while ((job = Next(worker)) != NULL) {
+      cYaepgImage *image = Load(job->key, job->file.c_str(), job);
+      if (image != NULL) {
+         cache.Put(job->key, image);
+      }
+      job->Finish(image);
+      job->Unref();
+   }
+}
+
+/*
+ * Starts prescaling the image directory for a widget size, if that isn't
+ * already running.
+ */
+void
+cYaepgImageLoader::Index(int width, int height, int mode)
+{
+   if (sThumbDir.empty() || (indexer != NULL && indexer->Matches(width, height, mode))) {
+      return;
+   }
+   delete indexer;
+   indexer = new cYaepgThumbIndexer(width, height, mode);
+}
+
+/*
+ * Returns the image for a key, from its thumbnail if there is one and
+ * decoded from the file otherwise.
+ */
+cYaepgImage *
+cYaepgImageLoader::Load(const tImageKey &key, const char *file, const cYaepgImageJob *job)
+{
+   cYaepgImage *image = ReadThumb(key);
+   if (image != NULL) {
+      return image;
+   }
+
+   std::vector< tColor > pixels;
+   std::vector< tColor > palette;
+   std::vector< tIndex > indexes;
+   if (!Decode(file, key.width, key.height, key.mode, job, pixels) ||
+       !Palettize(pixels, palette, indexes)) {
+      return NULL;
+   }
+   WriteThumb(key, palette, indexes);
+   return Image(key.width, key.height, &palette[0], (int)palette.size(), &indexes[0]);
+}
+
+/*
+ *****************************************************************************
+ * Scaling decoders
+ *
+ * EPG images are usually much larger than the image box.  JPEG images are
+ * decoded right at 1/2, 1/4 or 1/8 of their size by libjpeg's DCT scaling
+ * and PNG images are read row by row and averaged down by an integer factor,
+ * both only as far as the result still covers the box.  The final resample
+ * and quantize are left to Magick++, which also reads all other formats.
+ *****************************************************************************
+ */
+struct tScaledPixels {
+   int width;
+   int height;
+   std::vector< unsigned char > rgb;
+   std::vector< unsigned char > row;
+   std::vector< unsigned int > sums;
+};
+
+#ifdef HAVE_LIBJPEG
+struct tJpegError {
+   struct jpeg_error_mgr mgr;
+   jmp_buf jmp;
+};
+
+static void
+JpegErrorExit(j_common_ptr cinfo)
+{
+   longjmp(((tJpegError *)cinfo->err)->jmp, 1);
+}
+
+static void
+JpegMessage(j_common_ptr /* cinfo */)
+{
+}
+
+/*
+ * The buffers are owned by the caller, nothing which is changed after the
+ * setjmp() may live in this frame.
+ */
+static bool
+ReadJpeg(FILE *fp, int width, int height, tScaledPixels &out)
+{
+   struct jpeg_decompress_struct cinfo;
+   tJpegError err;
+
+   cinfo.err = jpeg_std_error(&err.mgr);
+   err.mgr.error_exit = JpegErrorExit;
+   err.mgr.output_message = JpegMessage;
+   if (setjmp(err.jmp)) {
+      jpeg_destroy_decompress(&cinfo);
+      return false;
+   }
+   jpeg_create_decompress(&cinfo);
+   jpeg_stdio_src(&cinfo, fp);
+   jpeg_read_header(&cinfo, TRUE);
+
+   // largest reduction which still covers the box
+   cinfo.scale_num = 1;
+   cinfo.scale_denom = 1;
+   while (cinfo.scale_denom < 8 &&
+          ((int)cinfo.image_width / (int)(cinfo.scale_denom * 2) >= width ||
+           (int)cinfo.image_height / (int)(cinfo.scale_denom * 2) >= height)) {
+      cinfo.scale_denom *= 2;
+   }
+   cinfo.out_color_space = JCS_RGB;
+   cinfo.dct_method = JDCT_IFAST;
+   cinfo.do_fancy_upsampling = FALSE;
+
+   jpeg_start_decompress(&cinfo);
+   out.width = cinfo.output_width;
+   out.height = cinfo.output_height;
+   out.rgb.resize(out.width * out.height * 3);
+   while (cinfo.output_scanline < cinfo.output_height) {
+      JSAMPROW row = &out.rgb[cinfo.output_scanline * out.width * 3];
+      jpeg_read_scanlines(&cinfo, &row, 1);
+   }
+   jpeg_finish_decompress(&cinfo);
+   jpeg_destroy_decompress(&cinfo);
+
+   return true;
+}
+#endif
+
+#ifdef HAVE_LIBPNG
+static void
+PngError(png_structp png, png_const_charp /* msg */)
+{
+   longjmp(png_jmpbuf(png), 1);
+}
+
+static void
+PngWarning(png_structp /* png */, png_const_charp /* msg */)
+{
+}
+
+/*
+ * Interlaced images have to be read as a whole, they are left to Magick++.
+ * As with JPEG the buffers are owned by the caller.
+ */
+static bool
+ReadPng(FILE *fp, int width, int height, tScaledPixels &out)
+{
+   png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, PngError, PngWarning);
+   png_infop info = (png != NULL) ? png_create_info_struct(png) : NULL;
+
+   if (info == NULL || setjmp(png_jmpbuf(png))) {
+      png_destroy_read_struct(&png, &info, NULL);
+      return false;
+   }
+   png_init_io(png, fp);
+   png_read_info(png, info);
+   if (png_get_interlace_type(png, info) != PNG_INTERLACE_NONE) {
+      png_destroy_read_struct(&png, &info, NULL);
+      return false;
+   }
+
+   // the image is made opaque for the OSD anyway
+   png_set_expand(png);
+   png_set_strip_16(png);
+   png_set_strip_alpha(png);
+   png_set_gray_to_rgb(png);
+   png_read_update_info(png, info);
+
+   int w = png_get_image_width(png, info);
+   int h = png_get_image_height(png, info);
+   int f = MAX(1, MAX(w / width, h / height));
+   int ow = (w + f - 1) / f;
+   int oh = (h + f - 1) / f;
+
+   out.width = ow;
+   out.height = oh;
+   out.row.resize(png_get_rowbytes(png, info));
+   out.sums.assign(ow * 3, 0);
+   out.rgb.resize(ow * oh * 3);
+   for (int y = 0; y < h; y++) {
+      png_read_row(png, &out.row[0], NULL);
+      for (int x = 0; x < w; x++) {
+         for (int c = 0; c < 3; c++) {
+            out.sums[(x / f) * 3 + c] += out.row[x * 3 + c];
+         }
+      }
+      if ((y + 1) % f == 0 || y == h - 1) {
+         int ny = y % f + 1;
+         unsigned char *dst = &out.rgb[(y / f) * ow * 3];
+         for (int ox = 0; ox < ow; ox++) {
+            unsigned int n = MIN(f, w - ox * f) * ny;
+            for (int c = 0; c < 3; c++) {
+               dst[ox * 3 + c] = out.sums[ox * 3 + c] / n;
+               out.sums[ox * 3 + c] = 0;
+            }
+         }
+      }
+   }
+   png_read_end(png, NULL);
+   png_destroy_read_struct(&png, &info, NULL);
+
+   return true;
+}
+#endif
+
+/*
+ * Reads a JPEG or PNG image reduced close to the given size, returns false
+ * for other formats or when the file couldn't be read this way.
+ */
+#if defined(HAVE_LIBJPEG) || defined(HAVE_LIBPNG)
+static bool
+ReadScaled(const char *file, int width, int height, Magick::Image &image)
+{
+   unsigned char magic[8];
+   tScaledPixels out;
+   bool ok = false;
+   FILE *fp = fopen(file, "rb");
+
+   if (fp == NULL) {
+      return false;
+   }
+   if (fread(magic, 1, sizeof(magic), fp) == sizeof(magic)) {
+      rewind(fp);
+#ifdef HAVE_LIBJPEG
+      if (magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF) {
+         ok = ReadJpeg(fp, width, height, out);
+      }
+#endif
+#ifdef HAVE_LIBPNG
+      if (png_sig_cmp(magic, 0, sizeof(magic)) == 0) {
+         ok = ReadPng(fp, width, height, out);
+      }
+#endif
+   }
+   fclose(fp);
+
+   if (ok) {
+      image = Magick::Image(out.width, out.height, "RGB", Magick::CharPixel, &out.rgb[0]);
+   }
+   return ok;
+}
+#else
+static bool
+ReadScaled(const char * /* file */, int /* width */, int /* height */, Magick::Image & /* image */)
+{
+   return false;
+}
+#endif
+
+/*
+ * Reads an image, scales it to fit the given size and returns the pixels of
+ * that size with the image centered.  Gives up between the steps when the
+ * job has been cancelled.
+ */
+bool
+cYaepgImageLoader::Decode(const char *file, int width, int height, int mode, const cYaepgImageJob *job, std::vector< tColor > &pixels)
+{
+   Magick::Image image;
+
+   try {
+      Magick::Geometry geo;
+      if (!ReadScaled(file, width, height, image)) {
+         image.read(file);
+      }
+      if (job != NULL && job->Cancelled()) {
+         return false;
+      }
+      geo = image.size();
+      int w = geo.width();
+      int h = geo.height();
+      if (height != h || width != w) {
+         switch (mode) {
+         case 0:
+            image.sample(Magick::Geometry(width, height));
+            break;
+         case 1:
+            image.scale(Magick::Geometry(width, height));
+            break;
+         case 2:
+            image.zoom(Magick::Geometry(width, height));
+            break;
+         default:
+            YAEPG_ERROR("ERROR: unknown resize mode %d", mode);
+            break;
+         }
+         geo = image.size();
+      }
+      w = MIN((int)geo.width(), width);
+      h = MIN((int)geo.height(), height);
+      if (job != NULL && job->Cancelled()) {
+         return false;
+      }
+
+      image.opacity(Magick::OpaqueOpacity);
+      image.backgroundColor(Magick::Color(0, 0, 0, 0));
+      image.quantizeColorSpace(Magick::RGBColorspace);
+      image.quantizeColors(255);
+      image.quantize();
+      if (job != NULL && job->Cancelled()) {
+         return false;
+      }
+
+      // center image
+      pixels.assign(width * height, (tColor)clrTransparent);
+      tColor *dst = &pixels[((height - h) / 2) * width + (width - w) / 2];
+
+      const Magick::PixelPacket *pix = image.getConstPixels(0, 0, w, h);
+      for (int iy = 0; iy < h; ++iy) {
+         for (int ix = 0; ix < w; ++ix) {
+            dst[ix] = (~(int)(pix->opacity * 255 / MaxRGB) << 24)
+                    | ((int)(pix->red * 255 / MaxRGB) << 16)
+                    | ((int)(pix->green * 255 / MaxRGB) << 8)
+                    | (int)(pix->blue * 255 / MaxRGB);
+            ++pix;
+         }
+         dst += width;
+      }
+   } catch (Magick::Exception &e) {
+      YAEPG_ERROR("Couldn't load epg image %s, %s ", file, e.what());
+      return false;
+   } catch (...) {
+      YAEPG_ERROR("Couldn't load %s: Unknown exception caught", file);
+      return false;
+   }
+
+   YAEPG_INFO("Decoded epg image %s", file);
+   return true;
+}
+
+/*
+ * Splits the pixels into a palette and one index per pixel.  They are
+ * quantized to 255 colors already, the border adds transparent.
+ */
+bool
+cYaepgImageLoader::Palettize(const std::vector< tColor > &pixels, std::vector< tColor > &palette, std::vector< tIndex > &indexes)
+{
+   std::map< tColor, int > colors;
+
+   palette.clear();
+   indexes.resize(pixels.size());
+   for (int i = 0; i < (int)pixels.size(); i++) {
+      std::map< tColor, int >::const_iterator it = colors.find(pixels[i]);
+      if (it == colors.end()) {
+         if ((int)palette.size() == THUMB_PALETTE_SIZE) {
+            YAEPG_ERROR("Image has more than %d colors", THUMB_PALETTE_SIZE);
+            return false;
+         }
+         it = colors.insert(std::make_pair(pixels[i], (int)palette.size())).first;
+         palette.push_back(pixels[i]);
+      }
+      indexes[i] = (tIndex)it->second;
+   }
+   return !palette.empty();
+}
+
+/*
+ * The palette becomes the palette of the bitmap, so the indexes are set as
+ * they are.
+ */
+cYaepgImage *
+cYaepgImageLoader::Image(int width, int height, const tColor *palette, int colors, const tIndex *indexes)
+{
+   cBitmap *bmp = new cBitmap(width, height, 8);
+
+   for (int i = 0; i < colors; i++) {
+      bmp->SetColor(i, palette[i]);
+   }
+   for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+         bmp->SetIndex(x, y, *indexes++);
+      }
+   }
+   return new cYaepgImage(bmp);
+}
+
+cString
+cYaepgImageLoader::ThumbName(const tImageKey &key)
+{
+   return cString::sprintf("%s/%u-%dx%d-%d.thm", sThumbDir.c_str(), key.event, key.width, key.height, key.mode);
+}
+
+static bool
+ThumbMatches(const tThumbFileHeader &h, const tImageKey &key)
+{
+   return memcmp(h.magic, THUMB_FILE_MAGIC, sizeof(h.magic)) == 0 &&
+          h.version == THUMB_FILE_VERSION &&
+          h.colors > 0 && h.colors <= THUMB_PALETTE_SIZE &&
+          (int)h.width == key.width && (int)h.height == key.height &&
+          (int)h.mode == key.mode && h.mtime == (int64_t)key.mtime;
+}
+
+/*
+ * Reads the header of a thumbnail, of any version.
+ */
+bool
+cYaepgImageLoader::ThumbHeader(const char *name, tThumbFileHeader &h)
+{
+   int fd = open(name, O_RDONLY);
+
+   if (fd < 0) {
+      return false;
+   }
+   memset(&h, 0, sizeof(h));
+   bool ok = read(fd, &h, sizeof(h)) > (ssize_t)offsetof(tThumbFileHeader, version) &&
+             memcmp(h.magic, THUMB_FILE_MAGIC, sizeof(h.magic)) == 0;
+   close(fd);
+   return ok;
+}
+
+/*
+ * Whether there is a thumbnail for the key, only reads its header.
+ */
+bool
+cYaepgImageLoader::ThumbValid(const tImageKey &key)
+{
+   tThumbFileHeader h;
+
+   return ThumbHeader(ThumbName(key), h) && ThumbMatches(h, key);
+}
+
+cYaepgImage *
+cYaepgImageLoader::ReadThumb(const tImageKey &key)
+{
+   size_t size = sizeof(tThumbFileHeader) + THUMB_PALETTE_SIZE * sizeof(tColor) +
+                 (size_t)key.width * key.height * sizeof(tIndex);
+   struct stat st;
+   int fd;
+
+   if (sThumbDir.empty() || (fd = open(ThumbName(key), O_RDONLY)) < 0) {
+      return NULL;
+   }
+   if (fstat(fd, &st) < 0 || (size_t)st.st_size != size) {
+      close(fd);
+      return NULL;
+   }
+   void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (data == MAP_FAILED) {
+      return NULL;
+   }
+
+   const tThumbFileHeader *h = (const tThumbFileHeader *)data;
+   cYaepgImage *image = NULL;
+   if (ThumbMatches(*h, key)) {
+      const tColor *palette = (const tColor *)(h + 1);
+      image = Image(key.width, key.height, palette, h->colors, (const tIndex *)(palette + THUMB_PALETTE_SIZE));
+   }
+   munmap(data, size);
+
+   return image;
+}
+
+/*
+ * Several threads or VDR instances may write the same thumbnail, each one
+ * uses its own temporary file.
+ */
+void
+cYaepgImageLoader::WriteThumb(const tImageKey &key, const std::vector< tColor > &palette, const std::vector< tIndex > &indexes)
+{
+   static int tmpCount = 0;
+   tThumbFileHeader h;
+   tColor colors[THUMB_PALETTE_SIZE];
+
+   if (sThumbDir.empty()) {
+      return;
+   }
+
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, THUMB_FILE_MAGIC, sizeof(h.magic));
+   h.version = THUMB_FILE_VERSION;
+   h.width = key.width;
+   h.height = key.height;
+   h.mode = key.mode;
+   h.colors = palette.size();
+   h.mtime = key.mtime;
+
+   /* The palette is always stored in full, so the indexes start at a fixed offset */
+   memset(colors, 0, sizeof(colors));
+   memcpy(colors, &palette[0], palette.size() * sizeof(tColor));
+
+   cString name = ThumbName(key);
+   cString tmpName = cString::sprintf("%s.%d-%d.tmp", *name, (int)getpid(), __sync_add_and_fetch(&tmpCount, 1));
+   FILE *fp = fopen(tmpName, "w");
+   if (fp == NULL) {
+      YAEPG_ERROR("Can't write %s", *tmpName);
+      return;
+   }
+   bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+             fwrite(colors, sizeof(colors), 1, fp) == 1 &&
+             fwrite(&indexes[0], sizeof(indexes[0]), indexes.size(), fp) == indexes.size();
+   ok = (fclose(fp) == 0) && ok;
+   if (!ok || rename(tmpName, name) < 0) {
+      YAEPG_ERROR("Can't write %s", *name);
+      unlink(tmpName);
+   }
+}
@@ -0,0 +1,191 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#pragma once
+
+#include <deque>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <vdr/epg.h>
+#include <vdr/osd.h>
+#include <vdr/thread.h>
+
+/*
+ *****************************************************************************
+ * cYaepgImage
+ *
+ * An EPG image decoded and scaled for its widget, ready to be drawn.  Images
+ * are reference counted and never change once decoded.
+ *****************************************************************************
+ */
+class cYaepgImage {
+private:
+   mutable int refs;
+   cBitmap *bitmap;
+
+   ~cYaepgImage() { delete bitmap; }
+
+public:
+   cYaepgImage(cBitmap *_bitmap) : refs(1), bitmap(_bitmap) {}
+   void Ref(void) const { __sync_add_and_fetch(&refs, 1); }
+   void Unref(void) const { if (__sync_sub_and_fetch(&refs, 1) == 0) delete this; }
+   const cBitmap *Bitmap(void) const { return bitmap; }
+};
+
+/*
+ *****************************************************************************
+ * cYaepgImageCache
+ *
+ * The most recently decoded images, so going back to an event seen a moment
+ * ago draws its image right away.  An image is only valid for the file it
+ * was decoded from and the size and resize mode it was scaled with, all of
+ * which are part of the key.  The least recently used image is dropped when
+ * the cache is full.
+ *****************************************************************************
+ */
+struct tImageKey {
+   tEventID event;
+   time_t mtime;
+   int width;
+   int height;
+   int mode;
+
+   bool operator<(const tImageKey &other) const;
+};
+
+class cYaepgImageCache {
+private:
+   typedef std::list< std::pair< tImageKey, cYaepgImage * > > tImageList;
+
+   cMutex mutex;
+   int size;
+   tImageList images;
+   std::map< tImageKey, tImageList::iterator > index;
+   int hits;
+   int misses;
+
+public:
+   cYaepgImageCache(int _size);
+   ~cYaepgImageCache();
+   cYaepgImage *Get(const tImageKey &key);
+   void Put(const tImageKey &key, cYaepgImage *image);
+   cString Stats(void);
+};
+
+/*
+ *****************************************************************************
+ * cYaepgImageJob
+ *
+ * One image to be decoded by the loader.  The widget that submitted it polls
+ * Done() and takes the image from it, or cancels it when the image is no
+ * longer wanted; a cancelled job is skipped if it hasn't been started yet
+ * and otherwise dropped after the current decoding step.
+ *****************************************************************************
+ */
+class cYaepgImageJob {
+   friend class cYaepgImageLoader;
+
+private:
+   mutable int refs;
+   mutable cMutex mutex;
+   tImageKey key;
+   std::string file;
+   bool cancelled;
+   bool done;
+   cYaepgImage *image;
+
+   cYaepgImageJob(const tImageKey &_key, const char *_file);
+   ~cYaepgImageJob();
+   void Finish(cYaepgImage *_image);
+
+public:
+   void Ref(void) const { __sync_add_and_fetch(&refs, 1); }
+   void Unref(void) const { if (__sync_sub_and_fetch(&refs, 1) == 0) delete this; }
+   void Cancel(void);
+   bool Cancelled(void) const;
+   bool Done(void) const;
+   cYaepgImage *Image(void) const;
+};
+
+/*
+ *****************************************************************************
+ * cYaepgImageLoader
+ *
+ * Decodes EPG images in a small pool of worker threads, so reading, scaling
+ * and quantizing a large image doesn't block the OSD thread.  Images found
+ * in the cache are handed out as finished jobs right away.
+ *
+ * Decoded images are also saved as thumbnails: the final pixels at exactly
+ * the size of the image widget, stored as one palette index per pixel after
+ * a small header and the palette, so a file is simply mapped and its
+ * indexes set in a bitmap without looking up any colors.  A thumbnail is named after
+ * the event, size and resize mode and records the mtime of its image, so it
+ * is valid for exactly one key.  Files are written under a temporary name
+ * and renamed, several VDR instances on one host can share the thumbnail
+ * directory.  A low priority thread prescales the images of the whole
+ * image directory for the size of the current theme and removes the
+ * thumbnails whose image is gone or has been replaced, whatever size they
+ * were made for.
+ *****************************************************************************
+ */
+#define THUMB_FILE_MAGIC         "YAEPGTHM"
+#define THUMB_FILE_VERSION       2
+#define THUMB_PALETTE_SIZE       256
+
+struct tThumbFileHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t width;
+   uint32_t height;
+   uint32_t mode;
+   uint32_t colors;
+   uint32_t reserved;
+   int64_t mtime;
+};
+
+class cYaepgImageWorker;
+class cYaepgThumbIndexer;
+
+class cYaepgImageLoader {
+   friend class cYaepgImageWorker;
+   friend class cYaepgThumbIndexer;
+
+private:
+   static cYaepgImageLoader *instance;
+
+   cMutex mutex;
+   cCondVar jobCond;
+   std::deque< cYaepgImageJob * > jobs;
+   std::vector< cYaepgImageWorker * > workers;
+   cYaepgImageCache cache;
+   cYaepgThumbIndexer *indexer;
+
+   cYaepgImageLoader(void);
+   ~cYaepgImageLoader();
+   cYaepgImageJob *Next(cYaepgImageWorker *worker);
+   void Work(cYaepgImageWorker *worker);
+   static bool Decode(const char *file, int width, int height, int mode, const cYaepgImageJob *job, std::vector< tColor > &pixels);
+   static bool Palettize(const std::vector< tColor > &pixels, std::vector< tColor > &palette, std::vector< tIndex > &indexes);
+   static cYaepgImage *Image(int width, int height, const tColor *palette, int colors, const tIndex *indexes);
+   static cString ThumbName(const tImageKey &key);
+   static bool ThumbHeader(const char *name, tThumbFileHeader &h);
+   static bool ThumbValid(const tImageKey &key);
+   static cYaepgImage *ReadThumb(const tImageKey &key);
+   static void WriteThumb(const tImageKey &key, const std::vector< tColor > &palette, const std::vector< tIndex > &indexes);
+
+public:
+   static cYaepgImageLoader *Instance(void);
+   static void Destroy(void);
+   static cYaepgImage *Load(const tImageKey &key, const char *file, const cYaepgImageJob *job = NULL);
+   cYaepgImageJob *Submit(tEventID event, time_t mtime, const char *file, int width, int height, int mode);
+   void Index(int width, int height, int mode);
+   cString CacheStats(void) { return cache.Stats(); }
+};
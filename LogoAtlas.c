@@ -0,0 +1,305 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#include "LogoAtlas.h"
+
+#include "MenuSetupYaepg.h"
+#include "Utils.h"
+
+#include <Magick++.h>
+#include <algorithm>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ *****************************************************************************
+ * cYaepgLogoAtlas
+ *****************************************************************************
+ */
+std::vector< cYaepgLogoAtlas * > cYaepgLogoAtlas::atlases;
+
+cYaepgLogoAtlas::cYaepgLogoAtlas(const std::string &_theme, int _width, int _height) :
+   theme(_theme),
+   width(_width),
+   height(_height),
+   dirty(false)
+{
+}
+
+cYaepgLogoAtlas::~cYaepgLogoAtlas()
+{
+   for (int i = 0; i < (int)bitmaps.size(); i++) {
+      delete bitmaps[i];
+   }
+}
+
+/*
+ * Returns the atlas of the current theme for logos of the given size.
+ */
+cYaepgLogoAtlas *
+cYaepgLogoAtlas::Get(int width, int height)
+{
+   for (int i = 0; i < (int)atlases.size(); i++) {
+      cYaepgLogoAtlas *a = atlases[i];
+      if (a->theme == sThemeName && a->width == width && a->height == height) {
+         return a;
+      }
+   }
+
+   cYaepgLogoAtlas *a = new cYaepgLogoAtlas(sThemeName, width, height);
+   a->Read();
+   atlases.push_back(a);
+   return a;
+}
+
+void
+cYaepgLogoAtlas::Destroy(void)
+{
+   for (int i = 0; i < (int)atlases.size(); i++) {
+      if (atlases[i]->dirty) {
+         atlases[i]->Write();
+      }
+      delete atlases[i];
+   }
+   atlases.clear();
+}
+
+cString
+cYaepgLogoAtlas::FileName(void) const
+{
+   return cString::sprintf("%s/logos-%s-%dx%d.bin", sCacheDir.c_str(), theme.c_str(), width, height);
+}
+
+bool
+cYaepgLogoAtlas::Read(void)
+{
+   cString name = FileName();
+   tLogoFileHeader h;
+   struct stat st;
+   FILE *fp;
+
+   if (sCacheDir.empty() || (fp = fopen(name, "r")) == NULL) {
+      return false;
+   }
+
+   /* The number of logos must agree with the size of the file before anything is allocated */
+   size_t slotSize = sizeof(tLogoFileEntry) + (size_t)width * height * sizeof(tColor);
+   bool ok = fstat(fileno(fp), &st) == 0 &&
+             fread(&h, sizeof(h), 1, fp) == 1 &&
+             memcmp(h.magic, LOGO_FILE_MAGIC, sizeof(h.magic)) == 0 &&
+             h.version == LOGO_FILE_VERSION &&
+             (int)h.width == width && (int)h.height == height &&
+             (size_t)st.st_size >= sizeof(h) &&
+             ((size_t)st.st_size - sizeof(h)) / slotSize == h.logos &&
+             ((size_t)st.st_size - sizeof(h)) % slotSize == 0;
+   if (ok && h.logos > 0) {
+      entries.resize(h.logos);
+      pixels.resize((size_t)h.logos * width * height);
+      ok = fread(&entries[0], sizeof(entries[0]), entries.size(), fp) == entries.size() &&
+           fread(&pixels[0], sizeof(pixels[0]), pixels.size(), fp) == pixels.size();
+   }
+   fclose(fp);
+
+   if (!ok) {
+      YAEPG_ERROR("Ignoring invalid logo cache %s", *name);
+      entries.clear();
+      pixels.clear();
+      return false;
+   }
+
+   checked.assign(entries.size(), false);
+   for (int i = 0; i < (int)entries.size(); i++) {
+      entries[i].name[sizeof(entries[i].name) - 1] = '\0';
+      slots[entries[i].name] = i;
+      Build(i);
+   }
+
+   YAEPG_INFO("Read %d logos from %s", (int)entries.size(), *name);
+   return true;
+}
+
+/*
+ * Written under a temporary name and renamed, like the EPG index.
+ */
+bool
+cYaepgLogoAtlas::Write(void) const
+{
+   cString name = FileName();
+   tLogoFileHeader h;
+
+   if (sCacheDir.empty()) {
+      return false;
+   }
+
+   memset(&h, 0, sizeof(h));
+   memcpy(h.magic, LOGO_FILE_MAGIC, sizeof(h.magic));
+   h.version = LOGO_FILE_VERSION;
+   h.width = width;
+   h.height = height;
+   h.logos = entries.size();
+   h.saved = time(NULL);
+
+   cString tmpName = cString::sprintf("%s.tmp", *name);
+   FILE *fp = fopen(tmpName, "w");
+   if (fp == NULL) {
+      YAEPG_ERROR("Can't write %s", *tmpName);
+      return false;
+   }
+   bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+             (entries.empty() || fwrite(&entries[0], sizeof(entries[0]), entries.size(), fp) == entries.size()) &&
+             (pixels.empty() || fwrite(&pixels[0], sizeof(pixels[0]), pixels.size(), fp) == pixels.size());
+   ok = (fclose(fp) == 0) && ok;
+   if (!ok || rename(tmpName, name) < 0) {
+      YAEPG_ERROR("Can't write %s", *name);
+      unlink(tmpName);
+      return false;
+   }
+
+   YAEPG_INFO("Saved %d logos to %s", (int)entries.size(), *name);
+   return true;
+}
+
+/*
+ * Scales a logo to fit the slot, keeping its aspect ratio, and centers it.
+ */
+bool
+cYaepgLogoAtlas::Decode(const char *file, tColor *slot) const
+{
+   try {
+      Magick::Image image;
+      image.read(file);
+      image.zoom(Magick::Geometry(width, height));
+
+      int w = MIN((int)image.columns(), width);
+      int h = MIN((int)image.rows(), height);
+      tColor *dst = slot + ((height - h) / 2) * width + (width - w) / 2;
+
+      std::fill(slot, slot + width * height, (tColor)clrTransparent);
+      const Magick::PixelPacket *pix = image.getConstPixels(0, 0, w, h);
+      for (int iy = 0; iy < h; ++iy) {
+         for (int ix = 0; ix < w; ++ix) {
+            dst[ix] = (~(int)(pix->opacity * 255 / MaxRGB) << 24) |
+                       ((int)(pix->red * 255 / MaxRGB) << 16) |
+                       ((int)(pix->green * 255 / MaxRGB) << 8) |
+                        (int)(pix->blue * 255 / MaxRGB);
+            ++pix;
+         }
+         dst += width;
+      }
+   } catch (Magick::Exception &e) {
+      YAEPG_ERROR("Couldn't load logo %s: %s", file, e.what());
+      return false;
+   } catch (...) {
+      YAEPG_ERROR("Couldn't load logo %s: Unknown exception caught", file);
+      return false;
+   }
+   return true;
+}
+
+/*
+ * Returns the slot of the logo with the given name, -1 if there is none.
+ * Logos from the cache file are checked against their file once per run.
+ */
+int
+cYaepgLogoAtlas::Lookup(const std::string &name)
+{
+   std::map< std::string, int >::iterator it = slots.find(name);
+   if (it != slots.end() && (it->second < 0 || checked[it->second])) {
+      return it->second;
+   }
+
+   cString file = cString::sprintf("%s/%s.png", sLogoDir.c_str(), name.c_str());
+   struct stat st;
+   if (stat(file, &st) < 0) {
+      slots[name] = -1;
+      return -1;
+   }
+
+   int slot;
+   if (it != slots.end()) {
+      slot = it->second;
+      checked[slot] = true;
+      if (entries[slot].mtime == (int64_t)st.st_mtime) {
+         return slot;
+      }
+   } else {
+      tLogoFileEntry e;
+      memset(&e, 0, sizeof(e));
+      strn0cpy(e.name, name.c_str(), sizeof(e.name));
+      slot = entries.size();
+      entries.push_back(e);
+      checked.push_back(true);
+      pixels.resize(entries.size() * width * height);
+   }
+
+   entries[slot].mtime = st.st_mtime;
+   if (!Decode(file, &pixels[slot * width * height])) {
+      std::fill(pixels.begin() + slot * width * height,
+                pixels.begin() + (slot + 1) * width * height, (tColor)clrTransparent);
+   }
+   Build(slot);
+   slots[name] = slot;
+   dirty = true;
+
+   YAEPG_INFO("Logo '%s' in slot %d", name.c_str(), slot);
+   return slot;
+}
+
+int
+cYaepgLogoAtlas::Slot(const cChannel *chan)
+{
+   std::string name(chan->Name());
+
+   for (int i = 0; i < (int)name.size(); i++) {
+      name[i] = (name[i] == '/') ? '~' : tolower((unsigned char)name[i]);
+   }
+   int slot = Lookup(name);
+   if (slot < 0) {
+      slot = Lookup(*chan->GetChannelID().ToString());
+   }
+   return slot;
+}
+
+/*
+ * Turns a slot into a bitmap of its own.  Index 0 is kept transparent, it's
+ * what Draw() leaves out when overlaying the slot.
+ */
+void
+cYaepgLogoAtlas::Build(int slot)
+{
+   const tColor *src = &pixels[slot * width * height];
+   cBitmap *b = new cBitmap(width, height, 8);
+
+   b->SetColor(0, clrTransparent);
+   for (int iy = 0; iy < height; iy++) {
+      for (int ix = 0; ix < width; ix++) {
+         tColor col = *src++;
+         if ((col >> 24) != 0) {
+            b->DrawPixel(ix, iy, col);
+         }
+      }
+   }
+
+   if (slot < (int)bitmaps.size()) {
+      delete bitmaps[slot];
+   } else {
+      bitmaps.resize(slot + 1, NULL);
+   }
+   bitmaps[slot] = b;
+}
+
+/*
+ * Overlays a slot on the bitmap, its transparent pixels leave what's
+ * already there.
+ */
+void
+cYaepgLogoAtlas::Draw(cBitmap *bmp, int slot, int x, int y) const
+{
+   bmp->DrawBitmap(x, y, *bitmaps[slot], 0, 0, false, true);
+}
@@ -0,0 +1,80 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <vdr/channels.h>
+#include <vdr/osd.h>
+
+/*
+ *****************************************************************************
+ * cYaepgLogoAtlas
+ *
+ * Channel logos scaled to the size of the logo column and packed into one
+ * ARGB pixel array, one fixed size slot per logo.  A logo is read from the
+ * logo directory and scaled the first time a channel needs it.  Each slot
+ * is also turned into a bitmap once, drawing a page of logos then takes one
+ * DrawBitmap() per logo.  There is one atlas per theme and
+ * slot size; it's saved to the plugin cache directory on shutdown and read
+ * back when first needed, so logos are only decoded again when their file
+ * has changed.  Logos are looked up by the channel name in lower case (with
+ * '/' replaced by '~') and then by the channel ID, both with a .png suffix.
+ *****************************************************************************
+ */
+#define LOGO_FILE_MAGIC          "YAEPGLGO"
+#define LOGO_FILE_VERSION        1
+
+struct tLogoFileHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t width;
+   uint32_t height;
+   uint32_t logos;
+   int64_t saved;
+};
+
+struct tLogoFileEntry {
+   char name[64];
+   int64_t mtime;
+};
+
+class cYaepgLogoAtlas {
+private:
+   static std::vector< cYaepgLogoAtlas * > atlases;
+
+   std::string theme;
+   int width;
+   int height;
+   std::vector< tColor > pixels;
+   std::vector< cBitmap * > bitmaps;
+   std::vector< tLogoFileEntry > entries;
+   std::vector< bool > checked;
+   std::map< std::string, int > slots;
+   bool dirty;
+
+   cYaepgLogoAtlas(const std::string &_theme, int _width, int _height);
+   ~cYaepgLogoAtlas();
+   cString FileName(void) const;
+   bool Read(void);
+   bool Write(void) const;
+   bool Decode(const char *file, tColor *slot) const;
+   void Build(int slot);
+   int Lookup(const std::string &name);
+
+public:
+   static cYaepgLogoAtlas *Get(int width, int height);
+   static void Destroy(void);
+   int Width(void) const { return width; }
+   int Height(void) const { return height; }
+   int Slot(const cChannel *chan);
+   void Draw(cBitmap *bmp, int slot, int x, int y) const;
+};
@@ -17,13 +17,16 @@ int iMenuBackMenuItems       = 0;
 int iMenuBackSubMenuItems    = 0;
 int iTimeFormat              = TIME_FORMAT_12H;
 int iChannelOrder            = CHANNEL_ORDER_DOWN;
+int iChannelView             = CHANNEL_VIEW_ALL;
 int iChannelNumber           = false;
+int iWeekViewTime            = 2015;
 int iRecDlgRed               = false;
 int iInfoSymbols             = false;
 int iSwitchTimer             = false;
 int iSwitchMinsBefore        = 1;
 int iRemoteTimer             = false;
 int iEpgImages               = false;
+int iChannelLogos            = false;
 int iResizeImages            = 0;
 int iImageExtension          = 0;
 
@@ -37,13 +40,25 @@ int iReplaceOrgSchedule      = false;
 
 std::string sThemeName    = "default";
 std::string sThemeDir     = "";
+std::string sCacheDir     = "";
 std::string sEpgImagesDir = "/video/epgimages";
+std::string sLogoDir      = "";
+std::string sThumbDir     = "";
 int iVDRSymbols              = false;
 cPlugin*           pEPGSearch    = NULL;
 cPlugin*           pRemoteTimers = NULL;
 
 const char *imageExtensionTexts[3] = { "png", "jpg", "xpm" };
 
+const char *channelViewTexts[CHANNEL_VIEW_COUNT] = {
+   trNOOP("All channels"),
+   trNOOP("Current group"),
+   trNOOP("Current source"),
+   trNOOP("TV only"),
+   trNOOP("Free-to-air only"),
+   trNOOP("With EPG only")
+};
+
 void cMenuSetupYaepg::Store(void)
 {
    iHideMenuEntry      = iNewHideMenuEntry;
@@ -60,11 +75,14 @@ void cMenuSetupYaepg::Store(void)
    iRecDlgRed          = iNewRecDlgRed;
    iTimeFormat         = iNewTimeFormat;
    iChannelOrder       = iNewChannelOrder;
+   iChannelView        = iNewChannelView;
    iChannelNumber      = iNewChannelNumber;
+   iWeekViewTime       = iNewWeekViewTime;
    iInfoSymbols        = iNewInfoSymbols;
    iSwitchTimer        = iNewSwitchTimer;
    iRemoteTimer        = iNewRemoteTimer;
    iEpgImages          = iNewEpgImages;
+   iChannelLogos       = iNewChannelLogos;
    iResizeImages       = iNewResizeImages;
    iImageExtension  = iNewImageExtension;
    iSwitchMinsBefore = iNewSwitchMinsBefore;
@@ -92,12 +110,15 @@ void cMenuSetupYaepg::Store(void)
    SetupStore("RecDlgRed",          iRecDlgRed);
    SetupStore("TimeFormat",         iTimeFormat);
    SetupStore("ChannelOrder",       iChannelOrder);
+   SetupStore("ChannelView",        iChannelView);
    SetupStore("ChannelNumber",      iChannelNumber);
+   SetupStore("WeekViewTime",       iWeekViewTime);
    SetupStore("InfoSymbols",        iInfoSymbols);
    SetupStore("SwitchTimer",        iSwitchTimer);
    SetupStore("SwitchMinsBefore",   iSwitchMinsBefore);
    SetupStore("RemoteTimer",        iRemoteTimer);
    SetupStore("EpgImages",          iEpgImages);
+   SetupStore("ChannelLogos",       iChannelLogos);
    SetupStore("ResizeImages",       iResizeImages);
    SetupStore("ImageExtension",     iImageExtension);
    SetupStore("Theme",              sThemeName.c_str());
@@ -111,6 +132,10 @@ cMenuSetupYaepg::cMenuSetupYaepg(void)
    CH_ORDER_FORMATS[CHANNEL_ORDER_UP]   = tr("Up");
    CH_ORDER_FORMATS[CHANNEL_ORDER_DOWN] = tr("Down");
 
+   for (int i = 0; i < CHANNEL_VIEW_COUNT; i++) {
+      CH_VIEW_TYPES[i] = tr(channelViewTexts[i]);
+   }
+
    CH_CHANGE_MODES[CHANNEL_CHANGE_CLOSE]        = tr("Close YaepgHD");
    CH_CHANGE_MODES[CHANNEL_CHANGE_OPEN] = tr("Leave YaepgHD open");
    CH_CHANGE_MODES[CHANNEL_CHANGE_AUTOMATIC]     = tr("Automatic");
@@ -150,11 +175,14 @@ cMenuSetupYaepg::cMenuSetupYaepg(void)
    iNewRecDlgRed       = iRecDlgRed;
    iNewTimeFormat      = iTimeFormat;
    iNewChannelOrder    = iChannelOrder;
+   iNewChannelView     = iChannelView;
    iNewChannelNumber   = iChannelNumber;
+   iNewWeekViewTime    = iWeekViewTime;
    iNewInfoSymbols     = iInfoSymbols;
    iNewSwitchTimer     = iSwitchTimer;
    iNewRemoteTimer     = iRemoteTimer;
    iNewEpgImages       = iEpgImages;
+   iNewChannelLogos    = iChannelLogos;
    iNewResizeImages    = iResizeImages;
    iNewImageExtension  = iImageExtension;
    iNewSwitchMinsBefore= iSwitchMinsBefore;
@@ -185,7 +213,10 @@ void cMenuSetupYaepg::Create() {
    Add(new cMenuEditBoolItem (tr("Record dialog with red button"), &iNewRecDlgRed));
    Add(new cMenuEditStraItem (tr("Time format"), &iNewTimeFormat, TIME_FORMAT_COUNT, TIME_FORMATS));
    Add(new cMenuEditStraItem (tr("Channel order"), &iNewChannelOrder, CHANNEL_ORDER_COUNT, CH_ORDER_FORMATS));
+   Add(new cMenuEditStraItem (tr("Channel view"), &iNewChannelView, CHANNEL_VIEW_COUNT, CH_VIEW_TYPES));
    Add(new cMenuEditBoolItem (tr("Channel number"), &iNewChannelNumber));
+   Add(new cMenuEditBoolItem (tr("Channel logos"), &iNewChannelLogos));
+   Add(new cMenuEditTimeItem (tr("Week view time"), &iNewWeekViewTime));
 
    if (iVDRSymbols){
       Add(new cMenuEditBoolItem (tr("Info symbols"), &iNewInfoSymbols));
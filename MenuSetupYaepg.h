@@ -25,6 +25,17 @@ enum eChannelOrderType {
    CHANNEL_ORDER_COUNT
 };
 
+/* Channels shown in the guide */
+enum eChannelViewType {
+   CHANNEL_VIEW_ALL,
+   CHANNEL_VIEW_GROUP,
+   CHANNEL_VIEW_SOURCE,
+   CHANNEL_VIEW_TV,
+   CHANNEL_VIEW_FTA,
+   CHANNEL_VIEW_EPG,
+   CHANNEL_VIEW_COUNT
+};
+
 /* Manner in which channel is changed while in YAEPGHD */
 enum eChanneChangeType {
    CHANNEL_CHANGE_CLOSE,
@@ -40,13 +51,16 @@ extern int iMenuBackMenuItems;
 extern int iMenuBackSubMenuItems;
 extern int iTimeFormat;
 extern int iChannelOrder;
+extern int iChannelView;
 extern int iChannelNumber;
+extern int iWeekViewTime;
 extern int iRecDlgRed;
 extern int iInfoSymbols;
 extern int iSwitchTimer;
 extern int iSwitchMinsBefore;
 extern int iRemoteTimer;
 extern int iEpgImages;
+extern int iChannelLogos;
 extern int iResizeImages;
 extern int iImageExtension;
 extern int iHideMenuEntry;
@@ -59,12 +73,16 @@ extern int iReplaceOrgSchedule;
 
 extern std::string sThemeName;
 extern std::string sThemeDir;
+extern std::string sCacheDir;
 extern std::string sEpgImagesDir;
+extern std::string sLogoDir;
+extern std::string sThumbDir;
 extern int iVDRSymbols;
 extern cPlugin* pEPGSearch;
 extern cPlugin* pRemoteTimers;
 
 const extern char *imageExtensionTexts[3];
+const extern char *channelViewTexts[CHANNEL_VIEW_COUNT];
 
 /*
  *****************************************************************************
@@ -88,12 +106,15 @@ private:
    int iNewRecDlgRed;
    int iNewTimeFormat;
    int iNewChannelOrder;
+   int iNewChannelView;
    int iNewChannelNumber;
+   int iNewWeekViewTime;
    int iNewInfoSymbols;
    int iNewSwitchTimer;
    int iNewSwitchMinsBefore;
    int iNewRemoteTimer;
    int iNewEpgImages;
+   int iNewChannelLogos;
    int iNewResizeImages;
    int iNewImageExtension;
    int iNewThemeIndex;
@@ -101,6 +122,7 @@ private:
    int numThemes;
    const char *TIME_FORMATS[TIME_FORMAT_COUNT];
    const char *CH_ORDER_FORMATS[CHANNEL_ORDER_COUNT];
+   const char *CH_VIEW_TYPES[CHANNEL_VIEW_COUNT];
    const char *CH_CHANGE_MODES[CHANNEL_CHANGE_COUNT];
    const char *resizeImagesTexts[3];
 
@@ -0,0 +1,208 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#include "NowNext.h"
+
+#include "StateKeys.h"
+#include "Utils.h"
+
+#include <unistd.h>
+
+#include <vdr/thread.h>
+
+#define MAX_WORKERS              7
+#define MIN_CHUNK                128
+
+/*
+ *****************************************************************************
+ * cNowNextWorker
+ *
+ * Pool thread filling one chunk of entries per Run(), the pool lives until
+ * the plugin is stopped so building doesn't pay for thread creation.
+ *****************************************************************************
+ */
+class cNowNextWorker : public cThread {
+private:
+   cMutex mutex;
+   cCondVar jobCond;
+   cCondWait done;
+   const cSchedules *schedules;
+   tNowNextEntry *entries;
+   int count;
+   bool busy;
+
+protected:
+   virtual void Action(void);
+
+public:
+   cNowNextWorker(void);
+   ~cNowNextWorker();
+   void Run(const cSchedules *_schedules, tNowNextEntry *_entries, int _count);
+   void Wait(void) { done.Wait(); }
+};
+
+cNowNextWorker::cNowNextWorker(void) :
+   cThread("yaepghd now/next"),
+   schedules(NULL),
+   entries(NULL),
+   count(0),
+   busy(false)
+{
+   Start();
+}
+
+cNowNextWorker::~cNowNextWorker()
+{
+   Cancel(-1);
+   mutex.Lock();
+   jobCond.Broadcast();
+   mutex.Unlock();
+   Cancel(3);
+}
+
+void
+cNowNextWorker::Run(const cSchedules *_schedules, tNowNextEntry *_entries, int _count)
+{
+   cMutexLock lock(&mutex);
+
+   schedules = _schedules;
+   entries = _entries;
+   count = _count;
+   busy = true;
+   jobCond.Broadcast();
+}
+
+void
+cNowNextWorker::Action(void)
+{
+   cMutexLock lock(&mutex);
+
+   while (Running()) {
+      if (!busy) {
+         jobCond.Wait(mutex);
+         continue;
+      }
+      cYaepgNowNext::Fill(schedules, entries, count);
+      busy = false;
+      done.Signal();
+   }
+}
+
+/*
+ *****************************************************************************
+ * cYaepgNowNext
+ *****************************************************************************
+ */
+std::vector< cNowNextWorker * > cYaepgNowNext::workers;
+
+/*
+ * Runs in the worker threads while the building thread holds the schedules
+ * lock.  GetSchedule() caches the schedule in each channel, which is fine
+ * as every channel is handled by exactly one thread.
+ */
+void
+cYaepgNowNext::Fill(const cSchedules *schedules, tNowNextEntry *entries, int count)
+{
+   for (int i = 0; i < count; i++) {
+      tNowNextEntry &e = entries[i];
+      const cSchedule *sched = schedules->GetSchedule(e.chan);
+      const cEvent *present = sched ? sched->GetPresentEvent() : NULL;
+      const cEvent *following = sched ? sched->GetFollowingEvent() : NULL;
+
+      if (present != NULL) {
+         e.nowId = present->EventID();
+         e.nowTitle = present->Title() ? present->Title() : "";
+         e.nowStart = present->StartTime();
+         e.nowStop = present->EndTime();
+      } else {
+         e.nowId = 0;
+         e.nowTitle.clear();
+         e.nowStart = e.nowStop = 0;
+      }
+      if (following != NULL) {
+         e.nextTitle = following->Title() ? following->Title() : "";
+         e.nextStart = following->StartTime();
+      } else {
+         e.nextTitle.clear();
+         e.nextStart = 0;
+      }
+   }
+}
+
+void
+cYaepgNowNext::StopWorkers(void)
+{
+   for (int i = 0; i < (int)workers.size(); i++) {
+      delete workers[i];
+   }
+   workers.clear();
+}
+
+void
+cYaepgNowNext::Build(void)
+{
+   int n = 0;
+
+   YAEPG_CHANNELS_READ;
+   entries.resize(Channels->Count());
+   for (const cChannel *c = Channels->First(); c != NULL; c = Channels->Next(c)) {
+      if (!c->GroupSep()) {
+         tNowNextEntry &e = entries[n++];
+         e.chan = c;
+         e.number = c->Number();
+         e.id = c->GetChannelID();
+         e.name = c->Name();
+      }
+   }
+   entries.resize(n);
+   if (n == 0) {
+      return;
+   }
+
+   /* One chunk per core, but not for a handful of channels */
+   if (workers.empty()) {
+      int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+      for (int i = 0; i < MIN(cpus - 1, MAX_WORKERS); i++) {
+         workers.push_back(new cNowNextWorker);
+      }
+   }
+   int chunks = MAX(MIN((int)workers.size() + 1, n / MIN_CHUNK), 1);
+   int chunkSize = (n + chunks - 1) / chunks;
+
+   YAEPG_SCHEDULES_READ;
+   if (Schedules == NULL) {
+      for (int i = 0; i < n; i++) {
+         entries[i].nowId = 0;
+         entries[i].nowTitle.clear();
+         entries[i].nextTitle.clear();
+         entries[i].nowStart = entries[i].nowStop = entries[i].nextStart = 0;
+      }
+      return;
+   }
+
+   for (int i = 0; i < chunks - 1; i++) {
+      workers[i]->Run(Schedules, &entries[i * chunkSize], chunkSize);
+   }
+   Fill(Schedules, &entries[(chunks - 1) * chunkSize], n - (chunks - 1) * chunkSize);
+   for (int i = 0; i < chunks - 1; i++) {
+      workers[i]->Wait();
+   }
+
+   YAEPG_INFO("Now/next of %d channels in %d chunks", n, chunks);
+}
+
+int
+cYaepgNowNext::Find(const cChannel *chan) const
+{
+   for (int i = 0; i < (int)entries.size(); i++) {
+      if (entries[i].chan == chan) {
+         return i;
+      }
+   }
+   return -1;
+}
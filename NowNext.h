@@ -0,0 +1,57 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <vdr/channels.h>
+#include <vdr/epg.h>
+
+/*
+ *****************************************************************************
+ * cYaepgNowNext
+ *
+ * Snapshot of the present and following event of every channel.  The entries
+ * hold copies of the channel and event data, so they stay valid after the
+ * channels and schedules locks have been released; the channel pointer only
+ * identifies the channel.  Building splits the channel list into chunks which are
+ * looked up in parallel by a small pool of worker threads, the calling thread
+ * takes the last chunk itself.
+ *****************************************************************************
+ */
+struct tNowNextEntry {
+   const cChannel *chan;
+   int number;
+   tChannelID id;
+   std::string name;
+   tEventID nowId;
+   std::string nowTitle;
+   time_t nowStart;
+   time_t nowStop;
+   std::string nextTitle;
+   time_t nextStart;
+};
+
+class cNowNextWorker;
+
+class cYaepgNowNext {
+private:
+   static std::vector< cNowNextWorker * > workers;
+
+   std::vector< tNowNextEntry > entries;
+
+public:
+   static void Fill(const cSchedules *schedules, tNowNextEntry *entries, int count);
+   static void StopWorkers(void);
+   void Build(void);
+   int Count(void) const { return entries.size(); }
+   const tNowNextEntry &Entry(int i) const { return entries[i]; }
+   int Find(const cChannel *chan) const;
+};
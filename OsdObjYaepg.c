@@ -16,6 +16,9 @@
 #include <vdr/plugin.h>
 #include <vdr/remote.h>
 
+/* Automatic channel change waits for the cursor to rest this long */
+#define ZAP_DELAY_MS             500
+
 /*
  *****************************************************************************
  * cOsdObjYaepg
@@ -25,10 +28,14 @@ cOsdObjYaepg::cOsdObjYaepg(void) :
    theme(NULL),
    osd(NULL),
    startTime((time_t)0),
+   lastTick((time_t)0),
    mainBmp(NULL),
-   event(NULL),
+   channelViews(NULL),
+   channelView(CHANNEL_VIEW_ALL),
    lastInput(),
    directChan(0),
+   lastMove(),
+   pendingChan(0),
    needsRedraw(false),
    gridEvents(NULL),
    gridChans(NULL),
@@ -43,14 +50,22 @@ cOsdObjYaepg::cOsdObjYaepg(void) :
    timeLine(NULL),
    helpBar(NULL),
    recordDlg(NULL),
-   messageBox(NULL)
+   messageBox(NULL),
+   weekView(NULL),
+   nowNextView(NULL),
+   searchView(NULL)
 {
    memset(&mainWin, 0, sizeof(mainWin));
+   memset(&viewChans, 0, sizeof(viewChans));
    chanVec.clear();
 }
 
 cOsdObjYaepg::~cOsdObjYaepg()
 {
+   /* Don't lose a channel change still waiting for the cursor to rest */
+   if (pendingChan) {
+      SwitchToChannel(pendingChan, true);
+   }
    delete osd;
    delete mainBmp;
    delete gridEvents;
@@ -68,10 +83,17 @@ cOsdObjYaepg::~cOsdObjYaepg()
    delete helpBar;
    delete recordDlg;
    delete messageBox;
+   delete weekView;
+   delete nowNextView;
+   delete searchView;
+   if (channelViews != NULL) {
+      channelViews->Unref();
+   }
    cDevice::PrimaryDevice()->ScaleVideo(); // rescale to full size
 #ifdef YAEPGHD_REEL_EHD
    reelVidWin->Close();
 #endif
+   cYaepgTheme::Release(false);
 }
 
 void
@@ -119,22 +141,31 @@ cOsdObjYaepg::Show(void)
 #endif
 
    /* Create all the EPG widgets based on current channel/time */
-   UpdateChans(Channels.GetByNumber(cDevice::CurrentChannel()));
+   channelViews = cYaepgChannelIndex::Instance()->Acquire();
+   channelView = iChannelView;
+   const cChannel *chan;
+   {
+      YAEPG_CHANNELS_READ;
+      chan = Channels->GetByNumber(cDevice::CurrentChannel());
+   }
+   UpdateChans(chan);
 
    time_t t = time(NULL);
+   startTime = t;
+   lastTick = t;
    gridEvents = new cYaepgGrid(chanVec, t);
    gridChans = new cYaepgGridChans(chanVec);
    gridTime = new cYaepgGridTime(t);
    gridDate = new cYaepgGridDate(t);
    timeLine = new cYaepgTimeLine(t);
-   const cEvent *e = gridEvents->Event();
-   eventTitle = new cYaepgEventTitle(e);
-   eventInfo = new cYaepgEventInfo(e);
-   eventTime = new cYaepgEventTime(e);
-   eventDesc = new cYaepgEventDesc(e);
+   event = gridEvents->Event();
+   eventTitle = new cYaepgEventTitle(event);
+   eventInfo = new cYaepgEventInfo(event);
+   eventTime = new cYaepgEventTime(event);
+   eventDesc = new cYaepgEventDesc(event);
    eventDate = new cYaepgEventDate();
    if (iEpgImages)
-      eventEpgImage = new cYaepgEventEpgImage(e);
+      eventEpgImage = new cYaepgEventEpgImage(event.event.id);
    helpBar = new cYaepgHelpBar();
    recordDlg = NULL;
    messageBox = NULL;
@@ -154,41 +185,51 @@ cOsdObjYaepg::Show(void)
 void
 cOsdObjYaepg::AddDelTimer(void)
 {
-    const cEvent *event=gridEvents->Event();
-    eTimerMatch timerMatch = tmNone;
-    cTimer *ti;
-    ti=Timers.GetMatch(event, &timerMatch);
-    if (timerMatch==tmFull)
     {
-        if (ti)
-        {
-            ti->OnOff();
+        /* Same lock sequence as VDR's schedule menu, cTimer() locks the channels again */
+        YAEPG_TIMERS_WRITE;
+        YAEPG_CHANNELS_READ;
+        YAEPG_SCHEDULES_READ;
+        const cEvent *e = event.Find(Schedules);
+        if (e == NULL) {
+            return;
         }
-    }
-    else
-    {
-        cTimer *timer = new cTimer(event);
-        cTimer *t = Timers.GetTimer(timer);
-        if (t) {
-            t->OnOff();
-            delete timer;
+        eTimerMatch timerMatch = tmNone;
+        cTimer *ti;
+        ti=Timers->GetMatch(e, &timerMatch);
+        if (timerMatch==tmFull)
+        {
+            if (ti)
+            {
+                ti->OnOff();
+            }
         }
-        else {
-            Timers.Add(timer);
+        else
+        {
+            cTimer *timer = new cTimer(e);
+            cTimer *t = Timers->GetTimer(timer);
+            if (t) {
+                t->OnOff();
+                delete timer;
+            }
+            else {
+                Timers->Add(timer);
+            }
         }
+        Timers->SetModified();
     }
-    Timers.SetModified();
     eventInfo->UpdateEvent(event);
 }
 
 void
 cOsdObjYaepg::AddDelSwitchTimer()
 {
-    const cEvent *event = gridEvents->Event();
+    YAEPG_SCHEDULES_READ;
+    const cEvent *e = event.Find(Schedules);
     bool SwitchTimerExits = false;
-    if (pEPGSearch && event) {
+    if (pEPGSearch && e) {
         Epgsearch_switchtimer_v1_0* serviceData = new Epgsearch_switchtimer_v1_0;
-        serviceData->event = event;
+        serviceData->event = e;
         serviceData->mode = 0;
         if (pEPGSearch->Service("Epgsearch-switchtimer-v1.0", serviceData)){
             SwitchTimerExits=serviceData->success;
@@ -201,7 +242,7 @@ cOsdObjYaepg::AddDelSwitchTimer()
         }
         if (!SwitchTimerExits) {
             serviceData = new Epgsearch_switchtimer_v1_0;
-            serviceData->event = event;
+            serviceData->event = e;
             serviceData->mode = 1;
             serviceData->switchMinsBefore = iSwitchMinsBefore;
             serviceData->announceOnly = false;
@@ -224,7 +265,7 @@ cOsdObjYaepg::AddDelSwitchTimer()
         }
         else {
             serviceData = new Epgsearch_switchtimer_v1_0;
-            serviceData->event = event;
+            serviceData->event = e;
             serviceData->mode = 2;
             if (pEPGSearch->Service("Epgsearch-switchtimer-v1.0", serviceData)){
                 if (serviceData->success) {
@@ -252,46 +293,53 @@ cOsdObjYaepg::AddDelSwitchTimer()
 void
 cOsdObjYaepg::AddDelRemoteTimer()
 {
-   const cEvent *event=gridEvents->Event();
    if (pRemoteTimers) {
-      RemoteTimers_GetMatch_v1_0 rtMatch;
-      rtMatch.event = event;
-      pRemoteTimers->Service("RemoteTimers::GetMatch-v1.0", &rtMatch);
-      if (rtMatch.timerMatch == tmFull) {
-         if (rtMatch.timer) {
-            rtMatch.timer->OnOff();
-            RemoteTimers_Timer_v1_0 rt;
-            rt.timer = rtMatch.timer;
-            if (!pRemoteTimers->Service("RemoteTimers::ModTimer-v1.0", &rt)) {
-               messageBox = new cYaepgMsg();
-               messageBox->UpdateMsg((char*)*rt.errorMsg);
-               msgBoxStart = cTimeMs::Now();
-               needsRedraw = true;
-            }
+      {
+         YAEPG_CHANNELS_READ;
+         YAEPG_SCHEDULES_READ;
+         const cEvent *e = event.Find(Schedules);
+         if (e == NULL) {
+            return;
          }
-      }
-      else {
-         cTimer *timer = new cTimer(event);
-         RemoteTimers_Timer_v1_0 rt;
-         rt.timer = timer;
-         pRemoteTimers->Service("RemoteTimers::GetTimer-v1.0", &rt.timer);
-         if (rt.timer) {
-            rt.timer->OnOff();
-            if (!pRemoteTimers->Service("RemoteTimers::ModTimer-v1.0", &rt)) {
-               messageBox = new cYaepgMsg();
-               messageBox->UpdateMsg((char*)*rt.errorMsg);
-               msgBoxStart = cTimeMs::Now();
-               needsRedraw = true;
+         RemoteTimers_GetMatch_v1_0 rtMatch;
+         rtMatch.event = e;
+         pRemoteTimers->Service("RemoteTimers::GetMatch-v1.0", &rtMatch);
+         if (rtMatch.timerMatch == tmFull) {
+            if (rtMatch.timer) {
+               rtMatch.timer->OnOff();
+               RemoteTimers_Timer_v1_0 rt;
+               rt.timer = rtMatch.timer;
+               if (!pRemoteTimers->Service("RemoteTimers::ModTimer-v1.0", &rt)) {
+                  messageBox = new cYaepgMsg();
+                  messageBox->UpdateMsg((char*)*rt.errorMsg);
+                  msgBoxStart = cTimeMs::Now();
+                  needsRedraw = true;
+               }
             }
-            delete timer;
          }
          else {
+            cTimer *timer = new cTimer(e);
+            RemoteTimers_Timer_v1_0 rt;
             rt.timer = timer;
-            if (!pRemoteTimers->Service("RemoteTimers::NewTimer-v1.0", &rt)) {
-               messageBox = new cYaepgMsg();
-               messageBox->UpdateMsg((char*)*rt.errorMsg);
-               msgBoxStart = cTimeMs::Now();
-               needsRedraw = true;
+            pRemoteTimers->Service("RemoteTimers::GetTimer-v1.0", &rt.timer);
+            if (rt.timer) {
+               rt.timer->OnOff();
+               if (!pRemoteTimers->Service("RemoteTimers::ModTimer-v1.0", &rt)) {
+                  messageBox = new cYaepgMsg();
+                  messageBox->UpdateMsg((char*)*rt.errorMsg);
+                  msgBoxStart = cTimeMs::Now();
+                  needsRedraw = true;
+               }
+               delete timer;
+            }
+            else {
+               rt.timer = timer;
+               if (!pRemoteTimers->Service("RemoteTimers::NewTimer-v1.0", &rt)) {
+                  messageBox = new cYaepgMsg();
+                  messageBox->UpdateMsg((char*)*rt.errorMsg);
+                  msgBoxStart = cTimeMs::Now();
+                  needsRedraw = true;
+               }
             }
          }
       }
@@ -299,6 +347,34 @@ cOsdObjYaepg::AddDelRemoteTimer()
    }
 }
 
+eTimerMatch
+cOsdObjYaepg::TimerMatch(void)
+{
+   YAEPG_TIMERS_READ;
+   YAEPG_SCHEDULES_READ;
+   eTimerMatch timerMatch = tmNone;
+   const cEvent *e = event.Find(Schedules);
+
+   if (e != NULL) {
+      Timers->GetMatch(e, &timerMatch);
+   }
+   return timerMatch;
+}
+
+bool
+cOsdObjYaepg::HasRemoteTimer(void)
+{
+   YAEPG_SCHEDULES_READ;
+   RemoteTimers_Event_v1_0 rtEvent;
+
+   rtEvent.event = event.Find(Schedules);
+   rtEvent.timer = NULL;
+   if (rtEvent.event != NULL) {
+      pRemoteTimers->Service("RemoteTimers::GetTimerByEvent-v1.0", &rtEvent);
+   }
+   return rtEvent.timer != NULL;
+}
+
 eOSState
 cOsdObjYaepg::ProcessKey(eKeys key)
 {
@@ -340,7 +416,23 @@ cOsdObjYaepg::ProcessKey(eKeys key)
         }
     }
 
+    if (weekView != NULL && state == osUnknown) {
+        state = ProcessWeekKey(key);
+    }
+
+    if (nowNextView != NULL && state == osUnknown) {
+        state = ProcessNowNextKey(key);
+    }
+
+    if (searchView != NULL && state == osUnknown) {
+        state = ProcessSearchKey(key);
+    }
+
     if (state == osUnknown) {
+        /* The EPG may have changed since the cursor moved, act on the current data */
+        if (key != kNone && GridShown()) {
+            UpdateEvent(gridEvents->Event());
+        }
         switch (key & ~k_Repeat) {
         case kBack:
             if (iMenuBACK) {
@@ -375,17 +467,11 @@ cOsdObjYaepg::ProcessKey(eKeys key)
         case kUp:
              MoveCursor(DIR_UP);
              needsRedraw = true;
-             if (iChannelChange == CHANNEL_CHANGE_AUTOMATIC) {
-                SwitchToCurrentChannel();
-             }
              state = osContinue;
              break;
         case kDown:
              MoveCursor(DIR_DOWN);
              needsRedraw = true;
-             if (iChannelChange == CHANNEL_CHANGE_AUTOMATIC) {
-                SwitchToCurrentChannel();
-             }
              state = osContinue;
              break;
         case kOk:
@@ -397,21 +483,16 @@ cOsdObjYaepg::ProcessKey(eKeys key)
                 state = osEnd;
              }
              else {
-                 eTimerMatch timerMatch = tmNone;
-                 Timers.GetMatch(event, &timerMatch);
+                 eTimerMatch timerMatch = TimerMatch();
                  if (!(timerMatch==tmFull)){
                     if (iRemoteTimer && pRemoteTimers) {
-                        RemoteTimers_Event_v1_0 rtEvent;
-                        rtEvent.event = event;
-                        pRemoteTimers->Service("RemoteTimers::GetTimerByEvent-v1.0", &rtEvent);
-                        if (!(rtEvent.timer)){
+                        if (!HasRemoteTimer()){
                           recordDlg = new cYaepgRecDlg();
-                          recordDlg->UpdateEvent(gridEvents->Event());
+                          recordDlg->UpdateEvent(event);
                         }
                         else {
                             AddDelRemoteTimer();  // delete remote timer
-                            pRemoteTimers->Service("RemoteTimers::GetTimerByEvent-v1.0", &rtEvent);
-                            if (!(rtEvent.timer)) {
+                            if (!HasRemoteTimer()) {
                                 messageBox = new cYaepgMsg();
                                 messageBox->UpdateMsg(tr("Remote timer deactivated"));
                                 msgBoxStart = cTimeMs::Now();
@@ -421,13 +502,12 @@ cOsdObjYaepg::ProcessKey(eKeys key)
                     }
                     else {
                         recordDlg = new cYaepgRecDlg();
-                        recordDlg->UpdateEvent(gridEvents->Event());
+                        recordDlg->UpdateEvent(event);
                     }
                 }
                 else {
                     AddDelTimer();  // delete timer
-                    eTimerMatch timerMatch = tmNone;
-                    Timers.GetMatch(event, &timerMatch);
+                    eTimerMatch timerMatch = TimerMatch();
                     if (timerMatch==tmNone){
                         messageBox = new cYaepgMsg();
                         messageBox->UpdateMsg(tr("Timer deactivated"));
@@ -440,23 +520,18 @@ cOsdObjYaepg::ProcessKey(eKeys key)
             }
             break;
         case kRed:
-            if (event && event->EventID()!=0){
+            if (event.event.id != 0){
                 if (iRecDlgRed) {
-                    eTimerMatch timerMatch = tmNone;
-                    Timers.GetMatch(event, &timerMatch);
+                    eTimerMatch timerMatch = TimerMatch();
                     if (!(timerMatch==tmFull)){
                         if (iRemoteTimer && pRemoteTimers) {
-                            RemoteTimers_Event_v1_0 rtEvent;
-                            rtEvent.event = event;
-                            pRemoteTimers->Service("RemoteTimers::GetTimerByEvent-v1.0", &rtEvent);
-                            if (!(rtEvent.timer)){
+                            if (!HasRemoteTimer()){
                                 recordDlg = new cYaepgRecDlg();
-                                recordDlg->UpdateEvent(gridEvents->Event());
+                                recordDlg->UpdateEvent(event);
                             }
                             else{
                                 AddDelRemoteTimer();  // delete remote timer
-                                pRemoteTimers->Service("RemoteTimers::GetTimerByEvent-v1.0", &rtEvent);
-                                if (!(rtEvent.timer)) {
+                                if (!HasRemoteTimer()) {
                                     messageBox = new cYaepgMsg();
                                     messageBox->UpdateMsg(tr("Remote timer deactivated"));
                                     msgBoxStart = cTimeMs::Now();
@@ -466,13 +541,12 @@ cOsdObjYaepg::ProcessKey(eKeys key)
                         }
                         else {
                             recordDlg = new cYaepgRecDlg();
-                            recordDlg->UpdateEvent(gridEvents->Event());
+                            recordDlg->UpdateEvent(event);
                         }
                     }
                     else {
                         AddDelTimer();  // delete timer
-                        eTimerMatch timerMatch = tmNone;
-                        Timers.GetMatch(event, &timerMatch);
+                        eTimerMatch timerMatch = TimerMatch();
                         if (timerMatch==tmNone){
                             messageBox = new cYaepgMsg();
                             messageBox->UpdateMsg(tr("Timer deactivated"));
@@ -500,10 +574,31 @@ cOsdObjYaepg::ProcessKey(eKeys key)
             needsRedraw = true;
             state = osContinue;
             break;
+        case kChanUp:
+            UpdateGroup(1);
+            needsRedraw = true;
+            state = osContinue;
+            break;
+        case kChanDn:
+            UpdateGroup(-1);
+            needsRedraw = true;
+            state = osContinue;
+            break;
+        case kChannels:
+            UpdateView(1);
+            needsRedraw = true;
+            state = osContinue;
+            break;
         case kBlue:
             if (iSwitchTimer && pEPGSearch){
-                if (event && (event->EventID() != 0)){
-                    if (event->IsRunning(true)){
+                bool running;
+                {
+                    YAEPG_SCHEDULES_READ;
+                    const cEvent *e = event.Find(Schedules);
+                    running = e && e->IsRunning(true);
+                }
+                if (event.event.id != 0){
+                    if (running){
                         SwitchToCurrentChannel(true);
                         if (iChannelChange == CHANNEL_CHANGE_OPEN)
                             state = osContinue;
@@ -537,11 +632,37 @@ cOsdObjYaepg::ProcessKey(eKeys key)
             needsRedraw = true;
             state = osContinue;
             break;
+        case kNext:
+            weekView = new cYaepgWeekView(chanVec, iWeekViewTime);
+            weekView->Row(gridEvents->Row());
+            UpdateEvent(weekView->Event());
+            needsRedraw = true;
+            state = osContinue;
+            break;
+        case kInfo:
+            nowNextView = new cYaepgNowNextView(chanVec[gridEvents->Row()]);
+            UpdateEvent(nowNextView->Event());
+            needsRedraw = true;
+            state = osContinue;
+            break;
+        case kPrev:
+            searchView = new cYaepgSearchView();
+            UpdateEvent(searchView->Event());
+            needsRedraw = true;
+            state = osContinue;
+            break;
         case k0 ... k9:
             if (directChan || (key != k0)) {
                 directChan = ((directChan * 10) + ((key & ~k_Repeat) - k0)) % 100000;
                 gridDate->UpdateChan(directChan);
                 lastInput.Set(1000);
+
+                /* Preview the channel closest to the digits typed so far */
+                const cChannel *chan = channelViews->Nearest(directChan);
+                if (chan != NULL) {
+                    UpdateChans(chan);
+                    gridEvents->Row(0);
+                }
                 needsRedraw = true;
             }
         default:
@@ -554,15 +675,7 @@ cOsdObjYaepg::ProcessKey(eKeys key)
       YAEPG_INFO("Direct input timed out, channel %d", directChan);
 
       /* Look for a channel close to what the user entered */
-      cChannel *chan = NULL;
-      for (int i = 0; i < 500; i++) {
-         if ((chan = Channels.GetByNumber(directChan + i)) != NULL) {
-            break;
-         }
-         if ((chan = Channels.GetByNumber(directChan - i)) != NULL) {
-            break;
-         }
-      }
+      const cChannel *chan = channelViews->Nearest(directChan);
       if (chan != NULL) {
          UpdateChans(chan);
       }
@@ -577,15 +690,42 @@ cOsdObjYaepg::ProcessKey(eKeys key)
       needsRedraw = true;
    }
 
-   /* Uptate the grid time */
-   time_t now = time(NULL);
-   struct tm locNow, locStart;
-   localtime_r(&now, &locNow);
-   localtime_r(&startTime, &locStart);
-   if (locNow.tm_min != locStart.tm_min) {
+   /* Paint the EPG image as soon as the loader has decoded it */
+   if (iEpgImages && eventEpgImage != NULL && eventEpgImage->Poll()) {
+      DrawEpgImage();
+   }
+
+   /* Search as soon as typing pauses */
+   if (searchView != NULL && searchView->Poll()) {
+      UpdateEvent(searchView->Event());
       needsRedraw = true;
-      if (now > startTime) {
+   }
+
+   /* Automatic channel change, once the cursor rests on a channel */
+   if (pendingChan && lastMove.TimedOut()) {
+      SwitchToChannel(pendingChan);
+   }
+
+   /* Update the grid time once a minute */
+   time_t now = time(NULL);
+   if (now / 60 != lastTick / 60) {
+      lastTick = now;
+      if (GridShown() && startTime <= now &&
+          (now - (now % 1800)) != (startTime - (startTime % 1800))) {
+         /* The grid follows the current time into the next half hour */
          SetTime(now);
+         needsRedraw = true;
+      } else {
+         if (startTime <= now) {
+            startTime = now;
+         }
+         if (nowNextView != NULL) {
+            /* Present events change every minute somewhere, rebuild the list */
+            nowNextView->Update();
+            UpdateEvent(nowNextView->Event());
+            needsRedraw = true;
+         }
+         Tick(now);
       }
    }
 
@@ -603,30 +743,217 @@ cOsdObjYaepg::ProcessKey(eKeys key)
    return state;
 }
 
+/*
+ * Keys while the week view is shown, paging through the channels is left to
+ * the grid keys.
+ */
+eOSState
+cOsdObjYaepg::ProcessWeekKey(eKeys key)
+{
+   eCursorDir dir;
+
+   switch (key & ~k_Repeat) {
+   case kUp:
+      dir = DIR_UP;
+      break;
+   case kDown:
+      dir = DIR_DOWN;
+      break;
+   case kLeft:
+      dir = DIR_LEFT;
+      break;
+   case kRight:
+      dir = DIR_RIGHT;
+      break;
+   case kOk:
+   {
+      /* Open the grid at the selected slot */
+      time_t t = MAX(weekView->Time(), time(NULL));
+      int row = weekView->Row();
+      delete weekView;
+      weekView = NULL;
+      SetTime(t);
+      gridEvents->Select(row, t);
+      UpdateEvent(gridEvents->Event());
+      needsRedraw = true;
+      return osContinue;
+   }
+   case kBack:
+   case kNext:
+      delete weekView;
+      weekView = NULL;
+      SetTime(MAX(startTime, time(NULL)));
+      needsRedraw = true;
+      return osContinue;
+   case kGreen:
+   case kYellow:
+   case kChanUp:
+   case kChanDn:
+   case kChannels:
+      return osUnknown;
+   default:
+      return osContinue;
+   }
+
+   dir = GridDir(dir);
+   if (!weekView->MoveCursor(dir)) {
+      if (dir == DIR_UP) {
+         UpdateChans(1 * (iChannelOrder == CHANNEL_ORDER_UP ? 1 : -1));
+      } else if (dir == DIR_DOWN) {
+         UpdateChans(-1 * (iChannelOrder == CHANNEL_ORDER_UP ? 1 : -1));
+      }
+   }
+   UpdateEvent(weekView->Event());
+   needsRedraw = true;
+
+   return osContinue;
+}
+
+/*
+ * Keys while the now/next view is shown, Ok opens the grid at the selected
+ * channel.
+ */
+eOSState
+cOsdObjYaepg::ProcessNowNextKey(eKeys key)
+{
+   eCursorDir dir;
+
+   switch (key & ~k_Repeat) {
+   case kUp:
+      dir = DIR_UP;
+      break;
+   case kDown:
+      dir = DIR_DOWN;
+      break;
+   case kLeft:
+      dir = DIR_LEFT;
+      break;
+   case kRight:
+      dir = DIR_RIGHT;
+      break;
+   case kGreen:
+      nowNextView->MoveCursor((iChannelOrder == CHANNEL_ORDER_UP ? 1 : -1) * GRID_NUM_CHANS);
+      UpdateEvent(nowNextView->Event());
+      needsRedraw = true;
+      return osContinue;
+   case kYellow:
+      nowNextView->MoveCursor((iChannelOrder == CHANNEL_ORDER_UP ? -1 : 1) * GRID_NUM_CHANS);
+      UpdateEvent(nowNextView->Event());
+      needsRedraw = true;
+      return osContinue;
+   case kOk:
+   {
+      const cChannel *chan = nowNextView->Channel();
+      delete nowNextView;
+      nowNextView = NULL;
+      SetTime(MAX(startTime, time(NULL)));
+      if (chan != NULL) {
+         UpdateChans(chan);
+      }
+      gridEvents->Row(0);
+      UpdateEvent(gridEvents->Event());
+      needsRedraw = true;
+      return osContinue;
+   }
+   case kBack:
+   case kInfo:
+      delete nowNextView;
+      nowNextView = NULL;
+      SetTime(MAX(startTime, time(NULL)));
+      needsRedraw = true;
+      return osContinue;
+   default:
+      return osContinue;
+   }
+
+   dir = GridDir(dir);
+   if (dir == DIR_UP) {
+      nowNextView->MoveCursor(-1);
+   } else if (dir == DIR_DOWN) {
+      nowNextView->MoveCursor(1);
+   }
+   UpdateEvent(nowNextView->Event());
+   needsRedraw = true;
+
+   return osContinue;
+}
+
+/*
+ * Keys while the search view is shown, the number keys and Left edit the
+ * query, Ok opens the grid at the channel and time of the selected event.
+ */
+eOSState
+cOsdObjYaepg::ProcessSearchKey(eKeys key)
+{
+   switch (key & ~k_Repeat) {
+   case k0 ... k9:
+   case kLeft:
+      if (!searchView->ProcessInput(key)) {
+         return osContinue;
+      }
+      break;
+   case kUp:
+      searchView->MoveCursor(-1);
+      break;
+   case kDown:
+      searchView->MoveCursor(1);
+      break;
+   case kGreen:
+      searchView->MoveCursor((iChannelOrder == CHANNEL_ORDER_UP ? 1 : -1) * GRID_NUM_CHANS);
+      break;
+   case kYellow:
+      searchView->MoveCursor((iChannelOrder == CHANNEL_ORDER_UP ? -1 : 1) * GRID_NUM_CHANS);
+      break;
+   case kOk:
+   {
+      const tSearchHit *hit = searchView->Hit();
+      if (hit == NULL) {
+         return osContinue;
+      }
+      const cChannel *chan = hit->chan;
+      time_t t = MAX(hit->event.start, time(NULL));
+      delete searchView;
+      searchView = NULL;
+      SetTime(t);
+      UpdateChans(chan);
+      gridEvents->Select(0, t);
+      UpdateEvent(gridEvents->Event());
+      needsRedraw = true;
+      return osContinue;
+   }
+   case kBack:
+   case kPrev:
+      delete searchView;
+      searchView = NULL;
+      SetTime(MAX(startTime, time(NULL)));
+      needsRedraw = true;
+      return osContinue;
+   default:
+      return osContinue;
+   }
+
+   UpdateEvent(searchView->Event());
+   needsRedraw = true;
+
+   return osContinue;
+}
+
+/*
+ * Fills the grid starting at the given channel.  A channel that isn't in the
+ * view starts it at the next one that is; the group and source views follow
+ * the channel into its group or source.
+ */
 void
-cOsdObjYaepg::UpdateChans(cChannel *c)
+cOsdObjYaepg::UpdateChans(const cChannel *c)
 {
+   int step = (iChannelOrder == CHANNEL_ORDER_UP) ? -1 : 1;
+
+   viewChans = channelViews->View(channelView, c);
+   int first = channelViews->Find(viewChans, c);
+
    chanVec.resize(GRID_NUM_CHANS);
-   chanVec[0] = c;
-   for (int i = 1; i < GRID_NUM_CHANS; i++) {
-      if (iChannelOrder == CHANNEL_ORDER_UP) {
-         while ((c = (cChannel *)c->Prev()) && (c->GroupSep()));
-         if (c == NULL) {
-            c = Channels.Last();
-            while (c && c->GroupSep()) {
-               c = (cChannel *)c->Prev();
-            }
-         }
-      } else {
-         while ((c = (cChannel *)c->Next()) && (c->GroupSep()));
-         if (c == NULL) {
-            c = Channels.First();
-            while (c && (c->GroupSep())) {
-               c = (cChannel *)c->Next();
-            }
-         }
-      }
-      chanVec[i] = c;
+   for (int i = 0; i < GRID_NUM_CHANS; i++) {
+      chanVec[i] = channelViews->Get(viewChans, first + (i * step));
    }
 
    /* On first update, widgets haven't been created yet */
@@ -636,43 +963,53 @@ cOsdObjYaepg::UpdateChans(cChannel *c)
 
    gridEvents->UpdateChans(chanVec);
    gridChans->UpdateChans(chanVec);
-   UpdateEvent(gridEvents->Event());
+   if (weekView != NULL) {
+      weekView->UpdateChans(chanVec);
+      UpdateEvent(weekView->Event());
+   } else {
+      UpdateEvent(gridEvents->Event());
+   }
 }
 
 void
 cOsdObjYaepg::UpdateChans(int change)
 {
-   cChannel *c = chanVec[0];
+   const cChannel *c = channelViews->Get(viewChans, channelViews->Find(viewChans, chanVec[0]) + change);
 
-   YAEPG_INFO("Scrolling %d, current channel %d", change, c->Number());
+   YAEPG_INFO("Scrolling %d, new channel %d", change, c->Number());
 
-   if (change > 0) {
-      for (int i = 0; i < change; i++) {
-         while ((c = (cChannel *)c->Next()) && (c->GroupSep()));
-         if (c == NULL) {
-            c = Channels.First();
-            while (c && c->GroupSep()) {
-               c = (cChannel *)c->Next();
-            }
-         }
-      }
-   } else if (change < 0) {
-      for (int i = 0; i > change; i--) {
-         while ((c = (cChannel *)c->Prev()) && (c->GroupSep()));
-         if (c == NULL) {
-            c = Channels.Last();
-            while (c && c->GroupSep()) {
-               c = (cChannel *)c->Prev();
-            }
-         }
-      }
-   }
+   UpdateChans(c);
+}
 
-   YAEPG_INFO("New channel %d", c->Number());
+void
+cOsdObjYaepg::UpdateGroup(int change)
+{
+   const cChannel *c = channelViews->Group(chanVec[0], change);
+
+   YAEPG_INFO("Jumping %d groups, new channel %d", change, c->Number());
 
    UpdateChans(c);
 }
 
+/*
+ * Switches to the next (or previous) channel view, keeping the top channel
+ * if it's in the new view.
+ */
+void
+cOsdObjYaepg::UpdateView(int change)
+{
+   channelView = (channelView + change + CHANNEL_VIEW_COUNT) % CHANNEL_VIEW_COUNT;
+
+   YAEPG_INFO("Channel view %s", channelViewTexts[channelView]);
+
+   UpdateChans(chanVec[0]);
+
+   delete messageBox;
+   messageBox = new cYaepgMsg();
+   messageBox->UpdateMsg(tr(channelViewTexts[channelView]));
+   msgBoxStart = cTimeMs::Now();
+}
+
 void
 cOsdObjYaepg::SetTime(time_t newTime)
 {
@@ -703,11 +1040,11 @@ cOsdObjYaepg::UpdateTime(int change)
 }
 
 void
-cOsdObjYaepg::UpdateEvent(const cEvent *newEvent)
+cOsdObjYaepg::UpdateEvent(const tSelEvent &newEvent)
 {
    YAEPG_INFO("Updating event widgets");
 
-   if (event == newEvent) {
+   if (event.Same(newEvent)) {
       return;
    }
    event = newEvent;
@@ -716,15 +1053,22 @@ cOsdObjYaepg::UpdateEvent(const cEvent *newEvent)
    eventTime->UpdateEvent(event);
    eventDesc->UpdateEvent(event);
    if (iEpgImages)
-      eventEpgImage->UpdateEvent(event);
+      eventEpgImage->UpdateEvent(event.event.id);
 }
 
+/*
+ * Switches to a channel, any channel change still pending is dropped.
+ */
 void
-cOsdObjYaepg::SwitchToCurrentChannel(bool closeVidWin)
+#ifdef YAEPGHD_REEL_EHD
+cOsdObjYaepg::SwitchToChannel(int number, bool closeVidWin)
+#else
+cOsdObjYaepg::SwitchToChannel(int number, bool /* closeVidWin */)
+#endif
 {
-   const cChannel *gridChan = chanVec[gridEvents->Row()];
+   pendingChan = 0;
 
-   if (gridChan && (gridChan->Number() != cDevice::CurrentChannel())) {
+   if (number != cDevice::CurrentChannel()) {
       /*
        * The eHD card doesn't seem to like changing channels while the video
        * plane is scaled down.  To get around this problem we close/reopen the
@@ -735,7 +1079,10 @@ cOsdObjYaepg::SwitchToCurrentChannel(bool closeVidWin)
       cCondWait::SleepMs(100);
 #endif
 
-      Channels.SwitchTo(gridChan->Number());
+      {
+         YAEPG_CHANNELS_READ;
+         Channels->SwitchTo(number);
+      }
 
 #ifdef YAEPGHD_REEL_EHD
       if (closeVidWin == false) {
@@ -743,18 +1090,58 @@ cOsdObjYaepg::SwitchToCurrentChannel(bool closeVidWin)
       }
 #endif
    }
-   return;
+}
+
+void
+cOsdObjYaepg::SwitchToCurrentChannel(bool closeVidWin)
+{
+   const cChannel *gridChan = chanVec[gridEvents->Row()];
+
+   if (gridChan) {
+      SwitchToChannel(gridChan->Number(), closeVidWin);
+   }
+}
+
+eCursorDir
+cOsdObjYaepg::GridDir(eCursorDir dir)
+{
+   /* In the vertical layout left/right move across channels, up/down in time */
+   if (gridEvents->Vertical()) {
+      static const eCursorDir rotate[] = { DIR_LEFT, DIR_RIGHT, DIR_UP, DIR_DOWN };
+      return rotate[dir];
+   }
+   return dir;
 }
 
 void
 cOsdObjYaepg::MoveCursor(eCursorDir dir)
 {
+   dir = GridDir(dir);
+
    if (gridEvents->MoveCursor(dir)) {
       UpdateEvent(gridEvents->Event());
-      return;
+   } else {
+      ScrollGrid(dir);
    }
 
-   /* Need to scroll */
+   /*
+    * Tuning through every channel passed while a key is held would keep the
+    * tuner and decoder busy, so the switch waits until the cursor rests.  A
+    * further move replaces the pending channel.
+    */
+   if ((dir == DIR_UP || dir == DIR_DOWN) && iChannelChange == CHANNEL_CHANGE_AUTOMATIC) {
+      const cChannel *gridChan = chanVec[gridEvents->Row()];
+      if (gridChan) {
+         pendingChan = gridChan->Number();
+         lastMove.Set(ZAP_DELAY_MS);
+      }
+   }
+}
+
+void
+cOsdObjYaepg::ScrollGrid(eCursorDir dir)
+{
+   /* The cursor is at the edge of the grid, scroll the channels or the time */
    switch (dir) {
    case DIR_UP:
       UpdateChans(1 * (iChannelOrder == CHANNEL_ORDER_UP ? 1 : -1));
@@ -774,16 +1161,127 @@ cOsdObjYaepg::MoveCursor(eCursorDir dir)
    }
 }
 
+/*
+ * Minute tick within the same time window: only the clock, the progress
+ * fills and the now marker move, so just those parts of the screen are
+ * sent to the OSD.
+ */
+void
+cOsdObjYaepg::Tick(time_t now)
+{
+   std::vector< tGeom > dirty;
+   tGeom g;
+
+   if (GridShown()) {
+      /* The overlays are not part of the composed screen, copying it back removes them */
+      if (gridEvents->NowGeom(g)) {
+         dirty.push_back(g);
+      }
+      if (timeLine->Geom(g)) {
+         dirty.push_back(g);
+      }
+
+      gridEvents->Tick(now, mainBmp, dirty);
+      timeLine->UpdateTime(startTime);
+   }
+   eventDate->Update();
+   g = EVENT_DATE_GEOM;
+   CopyBitmapRect(mainBmp, BG_IMAGE, g);
+   eventDate->Draw(mainBmp);
+   dirty.push_back(g);
+
+   /* Dialogs are drawn over everything, leave it to a full redraw */
+   if (needsRedraw || recordDlg != NULL || messageBox != NULL) {
+      needsRedraw = true;
+      return;
+   }
+
+   for (int i = 0; i < (int)dirty.size(); i++) {
+      FlushRect(dirty[i]);
+   }
+   DrawOverlays(NULL);
+   osd->Flush();
+}
+
+/*
+ * Updates just the EPG image on the screen, unless a full redraw is due
+ * anyway.
+ */
+void
+cOsdObjYaepg::DrawEpgImage(void)
+{
+   tGeom g = eventEpgImage->Geom();
+
+   if (needsRedraw || recordDlg != NULL || messageBox != NULL) {
+      needsRedraw = true;
+      return;
+   }
+
+   CopyBitmapRect(mainBmp, BG_IMAGE, g);
+   eventEpgImage->Draw(mainBmp);
+   FlushRect(g);
+   DrawOverlays(NULL);
+   osd->Flush();
+}
+
+void
+cOsdObjYaepg::FlushRect(const tGeom &g)
+{
+   if (g.w <= 0 || g.h <= 0) {
+      return;
+   }
+
+   cBitmap part(g.w, g.h, mainBmp->Bpp(), g.x, g.y);
+   CopyBitmapRect(&part, mainBmp, g);
+   osd->DrawBitmap(g.x, g.y, part);
+}
+
+/*
+ * The now marker and the time line box go straight to the OSD (bmp == NULL),
+ * unless a dialog has to be drawn over them.
+ */
+void
+cOsdObjYaepg::DrawOverlays(cBitmap *bmp)
+{
+   tGeom g;
+
+   if (!GridShown()) {
+      return;
+   }
+
+   if (gridEvents->NowGeom(g)) {
+      if (bmp != NULL) {
+         bmp->DrawRectangle(g.x, g.y, g.x + g.w - 1, g.y + g.h - 1, GRID_NOW_COLOR);
+      } else {
+         osd->DrawRectangle(g.x, g.y, g.x + g.w - 1, g.y + g.h - 1, GRID_NOW_COLOR);
+      }
+   }
+   if (bmp != NULL) {
+      timeLine->Draw(bmp);
+   } else {
+      timeLine->Draw(osd);
+   }
+}
+
 void
 cOsdObjYaepg::Draw(void)
 {
    mainBmp->DrawBitmap(0, 0, *BG_IMAGE);
 
-   gridEvents->Draw(mainBmp);
-   gridChans->Draw(mainBmp);
-   gridTime->Draw(mainBmp);
+   if (searchView != NULL) {
+      searchView->Draw(mainBmp);
+   } else if (nowNextView != NULL) {
+      nowNextView->Draw(mainBmp);
+   } else if (weekView != NULL) {
+      weekView->Draw(mainBmp);
+      gridChans->Draw(mainBmp);
+   } else {
+      gridEvents->UpdateBadges();
+      gridEvents->Draw(mainBmp);
+      gridTime->Draw(mainBmp);
+      gridChans->Draw(mainBmp);
+   }
    gridDate->Draw(mainBmp);
-   timeLine->Draw(mainBmp);
    eventTitle->Draw(mainBmp);
    eventInfo->Draw(mainBmp);
    eventTime->Draw(mainBmp);
@@ -792,6 +1290,10 @@ cOsdObjYaepg::Draw(void)
    if (iEpgImages)
       eventEpgImage->Draw(mainBmp);
    helpBar->Draw(mainBmp);
+   bool dialog = (recordDlg != NULL || messageBox != NULL);
+   if (dialog) {
+      DrawOverlays(mainBmp);
+   }
    if (recordDlg != NULL) {
        recordDlg->Draw(mainBmp);
    }
@@ -800,6 +1302,9 @@ cOsdObjYaepg::Draw(void)
    }
 
    osd->DrawBitmap(0, 0, *mainBmp);
+   if (!dialog) {
+      DrawOverlays(NULL);
+   }
    cDevice::PrimaryDevice()->ScaleVideo(videoWindowRect); // scale to our desired video window size if supported
    osd->Flush();
 }
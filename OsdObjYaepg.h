@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include "ChannelIndex.h"
 #include "GuiElements.h"
 
 /*
@@ -20,13 +21,19 @@ private:
    cYaepgTheme *theme;
    cOsd *osd;
    time_t startTime;
+   time_t lastTick;
    tArea mainWin;
    cBitmap *mainBmp;
    cRect videoWindowRect;
-   std::vector< cChannel * > chanVec;
-   const cEvent *event;
+   std::vector< const cChannel * > chanVec;
+   const cYaepgChannelViews *channelViews;
+   int channelView;
+   tChannelView viewChans;
+   tSelEvent event;
    cTimeMs lastInput;
    int directChan;
+   cTimeMs lastMove;
+   int pendingChan;
    bool needsRedraw;
 
    cYaepgGrid *gridEvents;
@@ -43,6 +50,9 @@ private:
    cYaepgHelpBar *helpBar;
    cYaepgRecDlg *recordDlg;
    cYaepgMsg *messageBox;
+   cYaepgWeekView *weekView;
+   cYaepgNowNextView *nowNextView;
+   cYaepgSearchView *searchView;
    uint64_t msgBoxStart;
 
 public:
@@ -50,15 +60,30 @@ public:
    ~cOsdObjYaepg();
    virtual void Show(void);
    virtual eOSState ProcessKey(eKeys key);
+   eOSState ProcessWeekKey(eKeys key);
+   eOSState ProcessNowNextKey(eKeys key);
+   eOSState ProcessSearchKey(eKeys key);
+   bool GridShown(void) { return weekView == NULL && nowNextView == NULL && searchView == NULL; }
    void SetTime(time_t newTime);
-   void UpdateChans(cChannel *c);
+   void UpdateChans(const cChannel *c);
    void UpdateChans(int change);
+   void UpdateGroup(int change);
+   void UpdateView(int change);
    void UpdateTime(int change);
-   void UpdateEvent(const cEvent *newEvent);
+   void UpdateEvent(const tSelEvent &newEvent);
+   eCursorDir GridDir(eCursorDir dir);
    void MoveCursor(eCursorDir dir);
+   void ScrollGrid(eCursorDir dir);
+   void SwitchToChannel(int number, bool closeVidWin = false);
    void SwitchToCurrentChannel(bool closeVidWin = false);
    void AddDelTimer(void);
    void AddDelSwitchTimer(void);
    void AddDelRemoteTimer(void);
+   eTimerMatch TimerMatch(void);
+   bool HasRemoteTimer(void);
+   void Tick(time_t now);
+   void FlushRect(const tGeom &g);
+   void DrawEpgImage(void);
+   void DrawOverlays(cBitmap *bmp);
    void Draw(void);
 };
\ No newline at end of file
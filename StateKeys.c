@@ -0,0 +1,118 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#include "StateKeys.h"
+
+/*
+ *****************************************************************************
+ * cYaepgStateKeys
+ *****************************************************************************
+ */
+#if APIVERSNUM >= 20301
+cYaepgStateKeys::cYaepgStateKeys(void)
+{
+}
+
+/*
+ * A Get*Read() call only returns the list, locked, if its state differs from
+ * the key.  Each list is released right away, so the caller must not hold
+ * any of them.
+ */
+int
+cYaepgStateKeys::Changed(int keys)
+{
+   int changed = 0;
+
+   if ((keys & SK_TIMERS) && cTimers::GetTimersRead(timersKey) != NULL) {
+      timersKey.Remove();
+      changed |= SK_TIMERS;
+   }
+   if ((keys & SK_CHANNELS) && cChannels::GetChannelsRead(channelsKey) != NULL) {
+      channelsKey.Remove();
+      changed |= SK_CHANNELS;
+   }
+   if ((keys & SK_SCHEDULES) && cSchedules::GetSchedulesRead(schedulesKey) != NULL) {
+      schedulesKey.Remove();
+      changed |= SK_SCHEDULES;
+   }
+   return changed;
+}
+#else
+cYaepgStateKeys::cYaepgStateKeys(void) :
+   channelsCount(-1),
+   timersState(-1),
+   schedulesModified(-1)
+{
+}
+
+int
+cYaepgStateKeys::Changed(int keys)
+{
+   int changed = 0;
+
+   if ((keys & SK_TIMERS) && Timers.Modified(timersState)) {
+      changed |= SK_TIMERS;
+   }
+   if ((keys & SK_CHANNELS) && Channels.Count() != channelsCount) {
+      channelsCount = Channels.Count();
+      changed |= SK_CHANNELS;
+   }
+   if ((keys & SK_SCHEDULES) && cSchedules::Modified() != schedulesModified) {
+      /* Modified in this second, a further change would have the same time */
+      time_t modified = cSchedules::Modified();
+      schedulesModified = (modified < time(NULL)) ? modified : 0;
+      changed |= SK_SCHEDULES;
+   }
+   return changed;
+}
+#endif
+
+/*
+ *****************************************************************************
+ * cYaepgEpgLock
+ *****************************************************************************
+ */
+#if APIVERSNUM >= 20301
+cYaepgEpgLock::cYaepgEpgLock(int timeoutMs) :
+   channels(NULL),
+   schedules(NULL)
+{
+   channels = cChannels::GetChannelsRead(channelsKey, timeoutMs);
+   if (channels != NULL) {
+      schedules = cSchedules::GetSchedulesRead(schedulesKey, timeoutMs);
+   }
+}
+
+cYaepgEpgLock::~cYaepgEpgLock()
+{
+   if (schedules != NULL) {
+      schedulesKey.Remove();
+   }
+   if (channels != NULL) {
+      channelsKey.Remove();
+   }
+}
+#else
+cYaepgEpgLock::cYaepgEpgLock(int timeoutMs) :
+   schedulesLock(false, timeoutMs),
+   channels(NULL),
+   schedules(NULL)
+{
+   schedules = cSchedules::Schedules(schedulesLock);
+   if (schedules != NULL && ::Channels.Lock(false, timeoutMs)) {
+      channels = &::Channels;
+   }
+}
+
+cYaepgEpgLock::~cYaepgEpgLock()
+{
+   if (channels != NULL) {
+      ::Channels.Unlock();
+   }
+}
+#endif
@@ -0,0 +1,97 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#pragma once
+
+#include <vdr/config.h>
+#include <vdr/channels.h>
+#include <vdr/epg.h>
+#include <vdr/timers.h>
+
+/*
+ * Access to VDR's channels, timers and schedules.  Since VDR 2.3.1 the global
+ * lists are gone and LOCK_*_READ/WRITE declare a locked local pointer to the
+ * list instead.  With an older VDR the macros declare the same pointers to
+ * the global lists, so the code using them is the same for both.  With the
+ * new API the lists have to be locked in the order timers, channels,
+ * schedules and none of them may be locked twice by the same thread.
+ */
+#if APIVERSNUM >= 20301
+#define YAEPG_CHANNELS_READ      LOCK_CHANNELS_READ
+#define YAEPG_TIMERS_READ        LOCK_TIMERS_READ
+#define YAEPG_TIMERS_WRITE       LOCK_TIMERS_WRITE
+#define YAEPG_SCHEDULES_READ     LOCK_SCHEDULES_READ
+#else
+#define YAEPG_CHANNELS_READ      cChannels *Channels = &::Channels
+#define YAEPG_TIMERS_READ        cTimers *Timers = &::Timers
+#define YAEPG_TIMERS_WRITE       cTimers *Timers = &::Timers
+#define YAEPG_SCHEDULES_READ     cSchedulesLock SchedulesLock; \
+                                 const cSchedules *Schedules = cSchedules::Schedules(SchedulesLock)
+#endif
+
+/*
+ *****************************************************************************
+ * cYaepgStateKeys
+ *
+ * Tells which of the channels, timers and schedules have been modified since
+ * the previous call, using state keys with VDR 2.3.1 and later.  The first
+ * call reports all of them as modified.  Older versions of VDR don't keep a
+ * modification state for the channels, a change of their number is taken
+ * instead; they can't be edited while the guide is open anyway.
+ *****************************************************************************
+ */
+enum eStateKeys {
+   SK_CHANNELS  = 0x01,
+   SK_TIMERS    = 0x02,
+   SK_SCHEDULES = 0x04,
+   SK_ALL       = SK_CHANNELS | SK_TIMERS | SK_SCHEDULES
+};
+
+class cYaepgStateKeys {
+private:
+#if APIVERSNUM >= 20301
+   cStateKey channelsKey;
+   cStateKey timersKey;
+   cStateKey schedulesKey;
+#else
+   int channelsCount;
+   int timersState;
+   time_t schedulesModified;
+#endif
+
+public:
+   cYaepgStateKeys(void);
+   int Changed(int keys = SK_ALL);
+};
+
+/*
+ *****************************************************************************
+ * cYaepgEpgLock
+ *
+ * Read locks on the channels and the schedules which give up after a
+ * timeout, for threads that would rather try again later than block VDR.
+ * Channels() and Schedules() are NULL if the lock couldn't be taken.
+ *****************************************************************************
+ */
+class cYaepgEpgLock {
+private:
+#if APIVERSNUM >= 20301
+   cStateKey channelsKey;
+   cStateKey schedulesKey;
+#else
+   cSchedulesLock schedulesLock;
+#endif
+   const cChannels *channels;
+   const cSchedules *schedules;
+
+public:
+   cYaepgEpgLock(int timeoutMs);
+   ~cYaepgEpgLock();
+   const cChannels *Channels(void) const { return schedules ? channels : NULL; }
+   const cSchedules *Schedules(void) const { return channels ? schedules : NULL; }
+};
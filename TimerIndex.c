@@ -0,0 +1,173 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#include "TimerIndex.h"
+
+#include "GuiElements.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+#define INDEX_DAYS_BEFORE        1
+#define INDEX_DAYS_AFTER         15
+
+/*
+ *****************************************************************************
+ * cYaepgTimerIndex
+ *****************************************************************************
+ */
+cYaepgTimerIndex *cYaepgTimerIndex::instance = NULL;
+
+cYaepgTimerIndex::cYaepgTimerIndex(void) :
+   rangeStart(0),
+   rangeEnd(0),
+   version(0)
+{
+}
+
+cYaepgTimerIndex *
+cYaepgTimerIndex::Instance(void)
+{
+   if (instance == NULL) {
+      instance = new cYaepgTimerIndex;
+   }
+   return instance;
+}
+
+void
+cYaepgTimerIndex::Destroy(void)
+{
+   delete instance;
+   instance = NULL;
+}
+
+void
+cYaepgTimerIndex::AddSpan(const cTimer *ti, time_t start, time_t stop)
+{
+   if (stop <= rangeStart || start >= rangeEnd) {
+      return;
+   }
+
+   tTimerSpan span;
+   span.chan = ti->Channel();
+   span.start = start;
+   span.stop = stop;
+   span.maxStop = stop;
+   span.vps = ti->HasFlags(tfVps);
+   /* Only one day of a repeating timer can be the one being recorded */
+   time_t now = time(NULL);
+   span.recording = ti->Recording() && start <= now && now < stop;
+   spans.push_back(span);
+}
+
+void
+cYaepgTimerIndex::Build(time_t from)
+{
+   spans.clear();
+   rangeStart = cTimer::SetTime(from, 0) - (INDEX_DAYS_BEFORE * SECSINDAY);
+   rangeEnd = rangeStart + ((INDEX_DAYS_BEFORE + INDEX_DAYS_AFTER) * SECSINDAY);
+
+   YAEPG_TIMERS_READ;
+   for (const cTimer *ti = Timers->First(); ti; ti = Timers->Next(ti)) {
+      if (!ti->HasFlags(tfActive) || ti->Channel() == NULL) {
+         continue;
+      }
+      if (ti->IsSingleEvent()) {
+         AddSpan(ti, ti->StartTime(), ti->StopTime());
+         continue;
+      }
+
+      /* Expand repeating timers into one span per matching day */
+      int start = cTimer::TimeToInt(ti->Start());
+      int stop = cTimer::TimeToInt(ti->Stop());
+      if (stop <= start) {
+         stop += SECSINDAY;
+      }
+      for (time_t day = rangeStart; day < rangeEnd; day = cTimer::IncDay(day, 1)) {
+         if (ti->FirstDay() && day < cTimer::SetTime(ti->FirstDay(), 0)) {
+            continue;
+         }
+         if (ti->DayMatches(day)) {
+            AddSpan(ti, cTimer::SetTime(day, start), cTimer::SetTime(day, 0) + stop);
+         }
+      }
+   }
+
+   /*
+    * Sort by channel/start and keep a running maximum of the stop times per
+    * channel, so the join can drop every span ending before an event.
+    */
+   std::sort(spans.begin(), spans.end());
+   for (int i = 1; i < (int)spans.size(); i++) {
+      if (spans[i].chan == spans[i - 1].chan) {
+         spans[i].maxStop = MAX(spans[i].stop, spans[i - 1].maxStop);
+      }
+   }
+
+   YAEPG_INFO("Timer index rebuilt, %d spans", (int)spans.size());
+}
+
+int
+cYaepgTimerIndex::Update(time_t from, time_t to)
+{
+   if (stateKeys.Changed(SK_TIMERS) || from < rangeStart || to > rangeEnd) {
+      Build(from);
+      version++;
+   }
+   return version;
+}
+
+void
+cYaepgTimerIndex::Join(const cChannel *chan, const tEventSnap *events, int numEvents, uint16_t *flags) const
+{
+   tTimerSpan key;
+   key.chan = chan;
+   key.start = 0;
+
+   std::vector< tTimerSpan >::const_iterator lo, hi, it;
+   lo = std::lower_bound(spans.begin(), spans.end(), key);
+   key.start = rangeEnd + SECSINDAY;
+   hi = std::upper_bound(lo, spans.end(), key);
+
+   /* The events of a row are sorted by start time */
+   for (int i = 0; i < numEvents; i++) {
+      const tEventSnap &e = events[i];
+      uint16_t f = flags[i] & ~CELL_BADGES;
+
+      if (e.vps && (e.vps - e.start)) {
+         f |= CELL_VPS;
+      }
+
+      if (e.id != 0) {
+         time_t evStart = e.start;
+         time_t evEnd = evStart + e.duration;
+
+         while (lo != hi && lo->maxStop <= evStart) {
+            lo++;
+         }
+         for (it = lo; it != hi && it->start < evEnd; it++) {
+            if (it->stop <= evStart) {
+               continue;
+            }
+            if ((it->vps && e.vps && it->start == e.vps) ||
+                (it->start <= evStart && evEnd <= it->stop)) {
+               f |= CELL_TIMER;
+            } else {
+               f |= CELL_TIMER_PARTIAL;
+            }
+            if (it->recording) {
+               f |= CELL_RECORDING;
+            }
+         }
+         if (f & CELL_TIMER) {
+            f &= ~CELL_TIMER_PARTIAL;
+         }
+      }
+      flags[i] = f;
+   }
+}
@@ -0,0 +1,63 @@
+/*
+ * yaepghd.c: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ * Community Edition
+ */
+
+#pragma once
+
+#include <vector>
+
+#include <vdr/timers.h>
+
+#include "StateKeys.h"
+
+struct tEventSnap;
+
+/*
+ *****************************************************************************
+ * cYaepgTimerIndex
+ *
+ * Sorted list of the time spans covered by the active local timers, used to
+ * put timer/recording badges on all visible grid cells in one merge pass per
+ * channel instead of a GetMatch() walk per cell.  Repeating timers are
+ * expanded into single spans for the range around the grid.  The index is
+ * only rebuilt when the timers' state key changes or the grid moves
+ * out of the expanded range.
+ *****************************************************************************
+ */
+class cYaepgTimerIndex {
+private:
+   struct tTimerSpan {
+      const cChannel *chan;
+      time_t start;
+      time_t stop;
+      time_t maxStop;
+      bool vps;
+      bool recording;
+
+      bool operator<(const tTimerSpan &other) const {
+         return chan != other.chan ? chan < other.chan : start < other.start;
+      }
+   };
+
+   static cYaepgTimerIndex *instance;
+
+   std::vector< tTimerSpan > spans;
+   cYaepgStateKeys stateKeys;
+   time_t rangeStart;
+   time_t rangeEnd;
+   int version;
+
+   cYaepgTimerIndex(void);
+   void AddSpan(const cTimer *ti, time_t start, time_t stop);
+   void Build(time_t from);
+
+public:
+   static cYaepgTimerIndex *Instance(void);
+   static void Destroy(void);
+   int Update(time_t from, time_t to);
+   void Join(const cChannel *chan, const tEventSnap *events, int numEvents, uint16_t *flags) const;
+};
@@ -15,6 +15,7 @@
 #include <map>
 #include <assert.h>
 #include <getopt.h>
+#include <time.h>
 #ifdef YAEPGHD_REEL_EHD
 #include <curl/curl.h>
 #endif
@@ -24,8 +25,13 @@
 #include <vdr/interface.h>
 
 
+#include "ChannelIndex.h"
+#include "ImageIndex.h"
+#include "ImageLoader.h"
+#include "LogoAtlas.h"
 #include "MenuSetupYaepg.h"
 #include "OsdObjYaepg.h"
+#include "TimerIndex.h"
 #include "Utils.h"
 
 
@@ -83,7 +89,9 @@ cPluginYaepghd::CommandLineHelp(void)
 {
    // Return a string that describes all known command line options.
      return
-         "  -i <IMAGESDIR>, --epgimages=<IMAGESDIR> Set directory where epgimages are stored\n";
+         "  -i <IMAGESDIR>, --epgimages=<IMAGESDIR> Set directory where epgimages are stored\n"
+         "  -l <LOGODIR>,   --logos=<LOGODIR>       Set directory where channel logos are stored\n"
+         "  -t <THUMBDIR>,  --thumbs=<THUMBDIR>     Set directory where scaled epgimages are stored\n";
 }
 
 const char *cPluginYaepghd::MainMenuEntry(void)
@@ -102,14 +110,22 @@ cPluginYaepghd::ProcessArgs(int argc, char *argv[])
    // Implement command line argument processing here if applicable.
   static const struct option long_options[] = {
     { "epgimages", required_argument, NULL, 'i' },
+    { "logos",     required_argument, NULL, 'l' },
+    { "thumbs",    required_argument, NULL, 't' },
     { 0, 0, 0, 0 }
   };
   int c;
-  while ((c = getopt_long(argc, argv, "i:", long_options, NULL)) != -1) {
+  while ((c = getopt_long(argc, argv, "i:l:t:", long_options, NULL)) != -1) {
     switch (c) {
       case 'i':
         sEpgImagesDir=optarg;
         break;
+      case 'l':
+        sLogoDir=optarg;
+        break;
+      case 't':
+        sThumbDir=optarg;
+        break;
       default:
         return false;
     }
@@ -122,6 +138,16 @@ cPluginYaepghd::Initialize(void)
 {
    // Initialize any background activities the plugin shall perform.
    sThemeDir = cPlugin::ConfigDirectory(PLUGIN_NAME_I18N);
+   sCacheDir = cPlugin::CacheDirectory(PLUGIN_NAME_I18N);
+   if (sLogoDir.empty()) {
+      sLogoDir = sThemeDir + "/logos";
+   }
+   if (sThumbDir.empty()) {
+      sThumbDir = sCacheDir + "/thumbs";
+   }
+   if (!MakeDirs(sThumbDir.c_str(), true)) {
+      sThumbDir = "";
+   }
    return true;
 }
 
@@ -143,6 +169,8 @@ cPluginYaepghd::Start(void)
    if (!pRemoteTimers) {
       YAEPG_ERROR("RemoteTimers does not exist!");
    }
+   cYaepgEpgIndex::Instance();
+   cYaepgImageIndex::Instance();
    return true;
 }
 
@@ -150,6 +178,13 @@ void
 cPluginYaepghd::Stop(void)
 {
    // Stop any background activities the plugin is performing.
+   cYaepgNowNext::StopWorkers();
+   cYaepgEpgIndex::Destroy();
+   cYaepgChannelIndex::Destroy();
+   cYaepgLogoAtlas::Destroy();
+   cYaepgImageLoader::Destroy();
+   cYaepgImageIndex::Destroy();
+   cYaepgTimerIndex::Destroy();
 #ifdef YAEPGHD_REEL_EHD
    delete reelVidWin;
 #endif
@@ -185,6 +220,11 @@ cPluginYaepghd::WakeupTime(void)
 cOsdObject *
 cPluginYaepghd::MainMenuAction(void)
 {
+   /* Released again when the guide is closed */
+   if (!cYaepgTheme::Acquire(false)) {
+      YAEPG_ERROR("Benchmark running, not opening the guide");
+      return NULL;
+   }
    return new cOsdObjYaepg;
 }
 
@@ -216,12 +256,15 @@ cPluginYaepghd::SetupParse(const char *Name, const char *Value)
    else if (!strcasecmp(Name, "RecDlgRed")) { iRecDlgRed = atoi(Value); }
    else if (!strcasecmp(Name, "TimeFormat"))    { iTimeFormat = atoi(Value); }
    else if (!strcasecmp(Name, "ChannelOrder"))  { iChannelOrder = atoi(Value); }
+   else if (!strcasecmp(Name, "ChannelView"))   { iChannelView = atoi(Value); }
    else if (!strcasecmp(Name, "ChannelNumber")) { iChannelNumber = atoi(Value); }
+   else if (!strcasecmp(Name, "WeekViewTime"))  { iWeekViewTime = atoi(Value); }
    else if (!strcasecmp(Name, "InfoSymbols"))   { iInfoSymbols = atoi(Value); }
    else if (!strcasecmp(Name, "SwitchTimer"))   { iSwitchTimer = atoi(Value); }
    else if (!strcasecmp(Name, "SwitchMinsBefore")){ iSwitchMinsBefore = atoi(Value); }
    else if (!strcasecmp(Name, "RemoteTimer"))   { iRemoteTimer = atoi(Value); }
    else if (!strcasecmp(Name, "EpgImages"))     { iEpgImages = atoi(Value); }
+   else if (!strcasecmp(Name, "ChannelLogos"))  { iChannelLogos = atoi(Value); }
    else if (!strcasecmp(Name, "ResizeImages"))    { iResizeImages = atoi(Value); }
    else if (!strcasecmp(Name, "ImageExtension"))  { iImageExtension = atoi(Value); }
    else if (!strcasecmp(Name, "Theme"))         { Utf8Strn0Cpy(themeName, Value, sizeof(themeName)); sThemeName = themeName; }
@@ -247,21 +290,121 @@ cPluginYaepghd::Service(const char *Id, void *Data)
       return true;
    }
 #endif
+#endif
+#if !defined(MAINMENUHOOKSVERSION) || MAINMENUHOOKSVERSNUM < 10001
+   (void)Id;
+   (void)Data;
 #endif
    return false;
 }
 
+static uint64_t
+NowUs(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * Time the generation of the grid and channel widgets for a few grid sizes,
+ * once from scratch and once scrolling by a single row.
+ */
+static cString
+BenchmarkGrid(int loops)
+{
+   static const int rowCounts[] = { 7, 20, 40 };
+   std::vector< const cChannel * > allChans;
+   cString result("");
+
+   {
+      YAEPG_CHANNELS_READ;
+      for (const cChannel *c = Channels->First(); c; c = Channels->Next(c)) {
+         if (!c->GroupSep()) {
+            allChans.push_back(c);
+         }
+      }
+   }
+   if (allChans.empty()) {
+      return "No channels";
+   }
+   if (!cYaepgTheme::Instance()->Element("gridEventFont").init &&
+       !cYaepgTheme::Instance()->Load(sThemeName)) {
+      return cString::sprintf("Error loading theme %s", sThemeName.c_str());
+   }
+
+   for (int r = 0; r < (int)(sizeof(rowCounts) / sizeof(rowCounts[0])); r++) {
+      int rows = rowCounts[r];
+      std::vector< const cChannel * > chans;
+      time_t t = time(NULL);
+      uint64_t start, full, scroll;
+
+      for (int i = 0; i < rows; i++) {
+         chans.push_back(allChans[i % allChans.size()]);
+      }
+
+      start = NowUs();
+      for (int l = 0; l < loops; l++) {
+         cYaepgGrid grid(chans, t);
+         cYaepgGridChans gridChans(chans);
+      }
+      full = NowUs() - start;
+
+      cYaepgGrid grid(chans, t);
+      cYaepgGridChans gridChans(chans);
+      start = NowUs();
+      for (int l = 0; l < loops; l++) {
+         chans.erase(chans.begin());
+         chans.push_back(allChans[(rows + l) % allChans.size()]);
+         grid.UpdateChans(chans);
+         gridChans.UpdateChans(chans);
+      }
+      scroll = NowUs() - start;
+
+      result = cString::sprintf("%s%2d rows: generate %6d us, scroll %6d us\n", *result, rows,
+                                (int)(full / loops), (int)(scroll / loops));
+   }
+
+   return result;
+}
+
 const char **
 cPluginYaepghd::SVDRPHelpPages(void)
 {
    // Return help text for SVDRP commands this plugin implements
-   return NULL;
+   static const char *HelpPages[] = {
+      "BNCH [ <loops> ]\n"
+      "    Benchmark the grid generation with 7, 20 and 40 channel rows.",
+      "IMGS\n"
+      "    Show the hit and miss counts of the EPG image cache.",
+      NULL
+   };
+   return HelpPages;
 }
 
 cString
 cPluginYaepghd::SVDRPCommand(const char *Command, const char *Option, int &ReplyCode)
 {
    // Process SVDRP commands this plugin implements
+   if (strcasecmp(Command, "BNCH") == 0) {
+      int loops = (Option && *Option) ? atoi(Option) : 20;
+      if (loops <= 0) {
+         ReplyCode = 501;
+         return "Invalid number of loops";
+      }
+      /* The benchmark uses the guide's theme, it can't run while that is open */
+      if (!cYaepgTheme::Acquire(true)) {
+         ReplyCode = 550;
+         return "The guide is open";
+      }
+      cString result = BenchmarkGrid(loops);
+      cYaepgTheme::Release(true);
+      return result;
+   }
+   if (strcasecmp(Command, "IMGS") == 0) {
+      return cYaepgImageLoader::Instance()->CacheStats();
+   }
    return NULL;
 }
 